@@ -18,16 +18,66 @@ DEFINES +=  QT_DEPRECATED_WARNINGS
 
 SOURCES += \
     deliveryplanner.cpp \
-    event.cpp \
     main.cpp \
     deliveryviewer.cpp \
-    qcustomplot.cpp
+    qcustomplot.cpp \
+    spatialindex.cpp \
+    candidateneighbors.cpp \
+    twoopt.cpp \
+    oropt.cpp \
+    linkernighan.cpp \
+    stopstore.cpp \
+    nearestkernel.cpp \
+    bruteforceindex.cpp \
+    distancematrix.cpp \
+    savingsconstruction.cpp \
+    timewindows.cpp \
+    routeexchange.cpp \
+    pickupdeliverysearch.cpp \
+    insertionsearch.cpp \
+    heldkarp.cpp \
+    onetreebound.cpp \
+    spacefillingcurve.cpp \
+    greedyedgeconstruction.cpp \
+    delaunaytriangulation.cpp \
+    planningworker.cpp \
+    taskscheduler.cpp \
+    batchplanner.cpp
 
 HEADERS += \
     deliveryplanner.h \
     deliveryviewer.h \
-    event.h \
-    qcustomplot.h
+    qcustomplot.h \
+    spatialindex.h \
+    candidateneighbors.h \
+    distancefunction.h \
+    twoopt.h \
+    improvementbudget.h \
+    improvementscratch.h \
+    oropt.h \
+    linkernighan.h \
+    parallelfor.h \
+    stopstore.h \
+    nearestkernel.h \
+    bruteforceindex.h \
+    distancematrix.h \
+    savingsconstruction.h \
+    timewindows.h \
+    routeexchange.h \
+    pickupdeliverysearch.h \
+    insertionsearch.h \
+    heldkarp.h \
+    onetreebound.h \
+    spacefillingcurve.h \
+    greedyedgeconstruction.h \
+    parallelsort.h \
+    delaunaytriangulation.h \
+    planningworker.h \
+    plansnapshot.h \
+    routestream.h \
+    splitrandom.h \
+    taskscheduler.h \
+    batchplanner.h
 
 FORMS += \
     deliveryviewer.ui
@@ -0,0 +1,116 @@
+#include "batchplanner.h"
+#include <QElapsedTimer>
+#include <atomic>
+#include "parallelfor.h"
+
+BatchPlanner::BatchPlanner():
+    improvementStage(twoOptImprovement),
+    constructionMethod(nearestNeighborConstruction),
+    vehicleCount(1),
+    vehicleCapacity(0),
+    threadCount(0),
+    seed(1),
+    scheduler(nullptr)
+{
+
+}
+
+BatchPlanner::~BatchPlanner(){
+    qDeleteAll(planners);
+    delete scheduler;
+}
+
+// Selects the improvement stage and its budget; the budget applies to every instance on its own
+void BatchPlanner::SetImprovement(ImprovementStage stage, ImprovementBudget budget){
+    improvementStage = stage;
+    improvementBudget = budget;
+}
+
+// Selects the construction of the single vehicle tours
+void BatchPlanner::SetConstruction(ConstructionMethod method){
+    constructionMethod = method;
+}
+
+// Sets the number of vehicles and their capacity of every instance
+void BatchPlanner::SetFleet(int count, double capacity){
+    vehicleCount = count;
+    vehicleCapacity = capacity;
+}
+
+// Sets the number of instances that are planned at the same time
+void BatchPlanner::SetThreadCount(int count){
+    threadCount = count;
+    // The pool is started again with the new number of threads
+    delete scheduler;
+    scheduler = nullptr;
+}
+
+// Sets the seed of the batch. Every instance is planned with its own seed split from it by the instance's
+// index, so its plan does not depend on the thread that plans it or on the other instances.
+void BatchPlanner::SetSeed(quint64 seed){
+    this->seed = seed;
+}
+
+// The instances are planned on the batch's own pool. A batch that is planned from inside a pool uses that pool.
+TaskScheduler *BatchPlanner::Scheduler(){
+    if(TaskScheduler::Current())
+        return nullptr;
+    if(!scheduler)
+        scheduler = new TaskScheduler(threadCount);
+    return scheduler;
+}
+
+// Plans all instances and returns their plans in the order of the instances. Every thread takes the next
+// instance that nobody has taken yet, so a few large instances do not hold up the others. The stages of
+// an instance run on the thread that plans it: the instances are the parallel work.
+QVector<PlanningResult> BatchPlanner::Plan(const QVector<PlanningInstance> &instances){
+    QElapsedTimer timer;
+    timer.start();
+    TaskScheduler::Scope scope(Scheduler());
+    int threads = qMax(1, qMin(ParallelThreadCount(threadCount), instances.count()));
+    while(planners.count() < threads){
+        DeliveryPlanner *planner = new DeliveryPlanner();
+        planner->SetThreadCount(1);
+        planners.append(planner);
+    }
+    for(DeliveryPlanner *planner : planners){
+        planner->SetImprovement(improvementStage, improvementBudget);
+        planner->SetConstruction(constructionMethod);
+        planner->SetFleet(vehicleCount, vehicleCapacity);
+    }
+
+    QVector<PlanningResult> results(instances.count());
+    PlanningResult *result = results.data();
+    std::atomic<int> next(0);
+    ParallelFor(threads, threads, [&](int, int, int worker){
+        DeliveryPlanner *planner = planners.at(worker);
+        for(int i = next++; i < instances.count(); i = next++)
+            PlanInstance(planner, i, instances.at(i), result[i]);
+    });
+
+    report.instances = instances.count();
+    report.threads = threads;
+    report.milliseconds = timer.elapsed();
+    report.instancesPerSecond = 1000.0 * instances.count() / qMax<qint64>(1, report.milliseconds);
+    return results;
+}
+
+// Plans one instance with the planner of the calling thread. Reset() keeps the memory of the planner's
+// points, stop store, indexes, distance matrix, tour candidate lists, insertion search and the work arrays
+// of the improvement stages, which the next instance reuses. The planned route is handed over to the
+// result, which owns it from then on.
+void BatchPlanner::PlanInstance(DeliveryPlanner *planner, int index, const PlanningInstance &instance, PlanningResult &result) const{
+    planner->Reset();
+    planner->SetSeed(SplitRandom(seed).Split(index).Next());
+    planner->xDepot[0] = instance.xDepot;
+    planner->yDepot[0] = instance.yDepot;
+    for(int i = 0; i < instance.xDelivery.count(); i++)
+        planner->AddDeliveryPoint(instance.xDelivery.at(i), instance.yDelivery.at(i),
+                                  instance.demandDelivery.isEmpty() ? 1 : instance.demandDelivery.at(i));
+    for(int i = 0; i < instance.xPickup.count(); i++)
+        planner->AddPickupPoint(instance.xPickup.at(i), instance.yPickup.at(i));
+    result.length = planner->CalculateDeliveryPlan();
+    result.feasible = planner->FleetFeasible();
+    result.xPlanned.swap(planner->xPlanned);
+    result.yPlanned.swap(planner->yPlanned);
+}
@@ -0,0 +1,67 @@
+#ifndef BATCHPLANNER_H
+#define BATCHPLANNER_H
+
+#include <QVector>
+#include "deliveryplanner.h"
+#include "taskscheduler.h"
+
+// One independent planning problem of a batch
+struct PlanningInstance
+{
+    double xDepot, yDepot; // depot the routes start and end at
+    QVector<double> xDelivery, yDelivery; // delivery points
+    QVector<double> demandDelivery; // load every delivery point needs (empty: 1 each)
+    QVector<double> xPickup, yPickup; // pickup points
+    PlanningInstance(): xDepot(0), yDepot(0) {}
+};
+
+// Plan of one instance of a batch
+struct PlanningResult
+{
+    double length; // total length of the planned routes
+    QVector<double> xPlanned, yPlanned; // planned route (all vehicle routes joined at the depot)
+    bool feasible; // false if the plan needs more routes than there are vehicles
+    PlanningResult(): length(0), feasible(true) {}
+};
+
+// Throughput of the last batch
+struct BatchReport
+{
+    int instances; // number of planned instances
+    int threads; // number of instances that were planned at the same time
+    qint64 milliseconds; // runtime of the whole batch
+    double instancesPerSecond; // planned instances per second of runtime
+    BatchReport(): instances(0), threads(0), milliseconds(0), instancesPerSecond(0) {}
+};
+
+// Plans many independent instances concurrently, one instance per thread at a time. Every thread keeps
+// its own planner and plans all of its instances with it, so the planner's points, stop store, indexes
+// and the work arrays of its stages are reused instead of being allocated for every instance.
+class BatchPlanner
+{
+public:
+    BatchPlanner();
+    ~BatchPlanner();
+    void SetImprovement(ImprovementStage stage, ImprovementBudget budget = ImprovementBudget()); // selects the improvement stage of every instance
+    void SetConstruction(ConstructionMethod method); // selects the construction of the single vehicle tours
+    void SetFleet(int count, double capacity); // sets the number of vehicles and their capacity of every instance (<= 0: unlimited)
+    void SetThreadCount(int count); // sets the number of instances planned at the same time (0: one per core)
+    void SetSeed(quint64 seed); // sets the seed the seeds of the instances are split from
+    QVector<PlanningResult> Plan(const QVector<PlanningInstance> &instances); // plans all instances, results in the same order
+    BatchReport LastReport() const { return report; } // throughput of the last batch
+private:
+    QVector<DeliveryPlanner*> planners; // planner of every thread (created by the first batch that needs it)
+    ImprovementStage improvementStage; // selected improvement stage
+    ImprovementBudget improvementBudget; // iteration and time budget of the improvement stage
+    ConstructionMethod constructionMethod; // selected construction of the single vehicle tours
+    int vehicleCount; // number of vehicles
+    double vehicleCapacity; // load limit of every vehicle (<= 0: unlimited)
+    int threadCount; // number of instances planned at the same time (0: one per core)
+    quint64 seed; // seed the seeds of the instances are split from
+    TaskScheduler *scheduler; // pool the instances are planned on (created by the first batch, nullptr: none yet)
+    BatchReport report; // throughput of the last batch
+    TaskScheduler *Scheduler(); // the batch's pool, nullptr if the calling thread runs in a pool already
+    void PlanInstance(DeliveryPlanner *planner, int index, const PlanningInstance &instance, PlanningResult &result) const; // plans one instance
+};
+
+#endif // BATCHPLANNER_H
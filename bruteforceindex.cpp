@@ -0,0 +1,104 @@
+#include "bruteforceindex.h"
+#include "nearestkernel.h"
+
+#include <algorithm>
+#include <limits>
+
+BruteForceIndex::BruteForceIndex():
+    alive(0)
+{
+
+}
+
+// Stores all points (x[i], y[i]); the id of a point is its index i. The points are copied into the
+// vectors of the last build instead of sharing x and y, so neither side has to detach later.
+void BruteForceIndex::Build(const QVector<double> &x, const QVector<double> &y){
+    allX.resize(x.count()); allY.resize(y.count());
+    std::copy(x.constBegin(), x.constEnd(), allX.begin());
+    std::copy(y.constBegin(), y.constEnd(), allY.begin());
+    RestoreAll();
+}
+
+// Removes all points; the memory stays for the next Build()
+void BruteForceIndex::Clear(){
+    allX.clear(); allY.clear();
+    slotX.clear(); slotY.clear();
+    slotId.clear();
+    slotOf.clear();
+    alive = 0;
+}
+
+// Returns the id of the remaining point closest to (x, y). Slots are kept in ascending id order,
+// so the lowest slot on ties is the lowest id.
+int BruteForceIndex::Nearest(double x, double y) const{
+    if(alive == 0)
+        return -1;
+    int slot = NearestIndex(slotX.constData(), slotY.constData(), slotX.count(), x, y);
+    return slot < 0 ? -1 : slotId.at(slot);
+}
+
+// Removes a point by giving it a NaN coordinate, which the kernel skips
+void BruteForceIndex::Remove(int id){
+    if(!Contains(id))
+        return;
+    int slot = slotOf.at(id);
+    slotX[slot] = std::numeric_limits<double>::quiet_NaN();
+    slotY[slot] = std::numeric_limits<double>::quiet_NaN();
+    slotOf[id] = -1;
+    alive--;
+    // Do not scan more removed points than remaining ones
+    if(2 * alive < slotX.count() && slotX.count() > 64)
+        Compact();
+}
+
+// Brings back a removed point. Its slot is found by its id (the slots stay in ascending id order);
+// if it has been compacted away, it is inserted again at its place in that order.
+void BruteForceIndex::Restore(int id){
+    if(id < 0 || id >= allX.count() || Contains(id))
+        return;
+    int slot = std::lower_bound(slotId.begin(), slotId.end(), id) - slotId.begin();
+    if(slot == slotId.count() || slotId.at(slot) != id){
+        slotX.insert(slot, 0); slotY.insert(slot, 0);
+        slotId.insert(slot, id);
+        for(int i = slot + 1; i < slotId.count(); i++){
+            if(slotOf.at(slotId.at(i)) >= 0)
+                slotOf[slotId.at(i)] = i;
+        }
+    }
+    slotX[slot] = allX.at(id);
+    slotY[slot] = allY.at(id);
+    slotOf[id] = slot;
+    alive++;
+}
+
+// Brings back all removed points
+void BruteForceIndex::RestoreAll(){
+    int count = allX.count();
+    slotX.resize(count); slotY.resize(count);
+    slotId.resize(count);
+    slotOf.resize(count);
+    for(int i = 0; i < count; i++){
+        slotX[i] = allX.at(i);
+        slotY[i] = allY.at(i);
+        slotId[i] = i;
+        slotOf[i] = i;
+    }
+    alive = count;
+}
+
+// Moves the remaining points to the front of the slots, keeping their order
+void BruteForceIndex::Compact(){
+    int count = 0;
+    for(int slot = 0; slot < slotX.count(); slot++){
+        int id = slotId.at(slot);
+        if(slotOf.at(id) < 0)
+            continue;
+        slotX[count] = slotX.at(slot);
+        slotY[count] = slotY.at(slot);
+        slotId[count] = id;
+        slotOf[id] = count;
+        count++;
+    }
+    slotX.resize(count); slotY.resize(count);
+    slotId.resize(count);
+}
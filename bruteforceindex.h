@@ -0,0 +1,29 @@
+#ifndef BRUTEFORCEINDEX_H
+#define BRUTEFORCEINDEX_H
+
+#include <QVector>
+
+// Same interface as SpatialIndex, but every query scans all remaining points with the vectorized
+// NearestIndex kernel. For small instances this beats walking a tree.
+class BruteForceIndex
+{
+public:
+    BruteForceIndex();
+    void Build(const QVector<double> &x, const QVector<double> &y); // stores all points
+    void Clear(); // removes all points, keeps the memory for the next Build()
+    int Nearest(double x, double y) const; // id of the closest remaining point (lowest id on ties), -1 if empty
+    void Remove(int id); // removes a point (no-op if it is not contained)
+    void Restore(int id); // brings back a removed point (no-op if it is contained)
+    void RestoreAll(); // brings back all removed points
+    bool Contains(int id) const { return id >= 0 && id < slotOf.count() && slotOf.at(id) >= 0; } // true if the point was not removed
+    int Count() const { return alive; } // number of remaining points
+private:
+    QVector<double> allX, allY; // all points (index = id)
+    QVector<double> slotX, slotY; // stored points in ascending id order, NaN marks a removed point
+    QVector<int> slotId; // id of every stored point
+    QVector<int> slotOf; // slot of every id (-1 if removed)
+    int alive; // number of remaining points
+    void Compact(); // drops the removed points from the slots
+};
+
+#endif // BRUTEFORCEINDEX_H
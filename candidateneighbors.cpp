@@ -0,0 +1,154 @@
+#include "candidateneighbors.h"
+#include "spatialindex.h"
+#include "delaunaytriangulation.h"
+#include "parallelfor.h"
+
+#include <QPair>
+#include <algorithm>
+
+CandidateNeighbors::CandidateNeighbors()
+{
+
+}
+
+// Builds the candidate lists from the k nearest neighbors of every stop; the queries are split between the threads
+void CandidateNeighbors::BuildNearest(const QVector<double> &x, const QVector<double> &y, const QVector<int> &stops, int k, int threadCount){
+    int count = x.count();
+
+    // Only the given stops can become candidates
+    SpatialIndex &index = nearestIndex;
+    index.Build(x, y);
+    QVector<bool> listed(count, false);
+    for(int stop : stops)
+        listed[stop] = true;
+    for(int i = 0; i < count; i++){
+        if(!listed.at(i))
+            index.Remove(i);
+    }
+
+    // Collect up to k candidates per stop with a fixed stride, then compact them
+    foundNeighbors.resize(count * k);
+    foundCount.fill(0, count);
+    int *foundData = foundNeighbors.data(); // detach once, before the threads write to it
+    int *countData = foundCount.data();
+    ParallelFor(stops.count(), threadCount, [&](int begin, int end, int){
+        QVector<int> nearest;
+        for(int s = begin; s < end; s++){
+            int stop = stops.at(s);
+            // The stop itself is among its own nearest points
+            index.KNearest(x.at(stop), y.at(stop), k + 1, nearest);
+            for(int neighbor : nearest){
+                if(neighbor != stop && countData[stop] < k)
+                    foundData[stop * k + countData[stop]++] = neighbor;
+            }
+        }
+    });
+
+    offsets.resize(count + 1);
+    neighbors.clear();
+    offsets[0] = 0;
+    for(int i = 0; i < count; i++){
+        for(int j = 0; j < foundCount.at(i); j++)
+            neighbors.append(foundNeighbors.at(i * k + j));
+        offsets[i + 1] = neighbors.count();
+    }
+}
+
+// Builds the candidate lists from the Delaunay triangulation: the Delaunay neighbors of a stop surround it
+// in every direction, which the k nearest points of a stop in a dense cluster do not. Lists that are
+// shorter than k are filled up with the neighbors of the neighbors, at most secondRingLimit of every
+// neighbor: a stop in the middle of a ring of stops has all of them as Delaunay neighbors. Stops that are
+// listed already are found by a stamp per thread. The k nearest entries are kept, sorted by distance. The
+// lists are filled in parallel.
+void CandidateNeighbors::BuildDelaunay(const QVector<double> &x, const QVector<double> &y, const QVector<int> &stops, int k, int threadCount){
+    int count = x.count();
+    int secondRingLimit = 4 * k;
+    DelaunayTriangulation triangulation;
+    triangulation.Build(x, y, stops, threadCount);
+
+    foundNeighbors.resize(count * k);
+    foundCount.fill(0, count);
+    int *foundData = foundNeighbors.data(); // detach once, before the threads write to it
+    int *countData = foundCount.data();
+    ParallelFor(stops.count(), threadCount, [&](int begin, int end, int){
+        QVector<QPair<double, int>> list;
+        QVector<int> listedFor(count, -1); // stop whose list holds a stop already
+        for(int s = begin; s < end; s++){
+            int stop = stops.at(s);
+            list.clear();
+            listedFor[stop] = stop;
+            auto add = [&](int neighbor){
+                if(listedFor.at(neighbor) == stop)
+                    return;
+                listedFor[neighbor] = stop;
+                double dx = x.at(neighbor) - x.at(stop), dy = y.at(neighbor) - y.at(stop);
+                list.append(qMakePair(dx * dx + dy * dy, neighbor));
+            };
+            for(const int *neighbor = triangulation.Begin(stop); neighbor != triangulation.End(stop); ++neighbor)
+                add(*neighbor);
+            if(list.count() < k){
+                int ring = list.count();
+                for(int i = 0; i < ring; i++){
+                    int neighbor = list.at(i).second;
+                    const int *last = triangulation.Begin(neighbor) + qMin(secondRingLimit, (int)(triangulation.End(neighbor) - triangulation.Begin(neighbor)));
+                    for(const int *second = triangulation.Begin(neighbor); second != last; ++second)
+                        add(*second);
+                }
+            }
+            countData[stop] = std::min(k, list.count());
+            std::partial_sort(list.begin(), list.begin() + countData[stop], list.end());
+            for(int i = 0; i < countData[stop]; i++)
+                foundData[stop * k + i] = list.at(i).second;
+        }
+    });
+
+    offsets.resize(count + 1);
+    neighbors.clear();
+    offsets[0] = 0;
+    for(int i = 0; i < count; i++){
+        for(int j = 0; j < foundCount.at(i); j++)
+            neighbors.append(foundNeighbors.at(i * k + j));
+        offsets[i + 1] = neighbors.count();
+    }
+}
+
+// Keeps the candidates that belong to the same group (e.g. the same vehicle route), at most k per stop
+void CandidateNeighbors::BuildGrouped(const CandidateNeighbors &source, const QVector<int> &group, int k){
+    int count = group.count();
+    offsets.resize(count + 1);
+    neighbors.clear();
+    offsets[0] = 0;
+    for(int i = 0; i < count; i++){
+        int found = 0;
+        if(group.at(i) >= 0 && i < source.offsets.count() - 1){
+            for(const int *neighbor = source.Begin(i); neighbor != source.End(i) && found < k; neighbor++){
+                if(group.at(*neighbor) == group.at(i)){
+                    neighbors.append(*neighbor);
+                    found++;
+                }
+            }
+        }
+        offsets[i + 1] = neighbors.count();
+    }
+}
+
+// Keeps the candidates of the given stops that belong to the same group and numbers them locally, so a
+// stage that runs on one group only needs arrays of the size of the group
+void CandidateNeighbors::BuildLocal(const CandidateNeighbors &source, const QVector<int> &stops, const QVector<int> &group,
+                                    const QVector<int> &local, int k){
+    int count = stops.count();
+    offsets.resize(count + 1);
+    neighbors.clear();
+    offsets[0] = 0;
+    for(int i = 0; i < count; i++){
+        int stop = stops.at(i);
+        int found = 0;
+        for(const int *neighbor = source.Begin(stop); neighbor != source.End(stop) && found < k; neighbor++){
+            if(group.at(*neighbor) == group.at(stop)){
+                neighbors.append(local.at(*neighbor));
+                found++;
+            }
+        }
+        offsets[i + 1] = neighbors.count();
+    }
+}
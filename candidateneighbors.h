@@ -0,0 +1,34 @@
+#ifndef CANDIDATENEIGHBORS_H
+#define CANDIDATENEIGHBORS_H
+
+#include <QVector>
+#include "spatialindex.h"
+
+// Short, distance sorted lists of promising neighbors per stop. The improvement stages only
+// consider edges to these candidates instead of all pairs.
+class CandidateNeighbors
+{
+public:
+    CandidateNeighbors();
+    // Builds the lists from the k nearest neighbors among the given stops (stops not listed get empty lists)
+    void BuildNearest(const QVector<double> &x, const QVector<double> &y, const QVector<int> &stops, int k, int threadCount = 0);
+    // Builds the lists from the Delaunay neighbors among the given stops, filled up with their neighbors (at most k, nearest first)
+    void BuildDelaunay(const QVector<double> &x, const QVector<double> &y, const QVector<int> &stops, int k, int threadCount = 0);
+    // Builds the lists from the first k candidates of source that are in the same group as the stop (group -1: no candidates)
+    void BuildGrouped(const CandidateNeighbors &source, const QVector<int> &group, int k);
+    // Builds the lists of the local stops 0 .. m - 1 (local stop i is stops[i] in source): the first k candidates
+    // of source in the same group, numbered by their index in local
+    void BuildLocal(const CandidateNeighbors &source, const QVector<int> &stops, const QVector<int> &group,
+                    const QVector<int> &local, int k);
+    const int *Begin(int stop) const { return neighbors.constData() + offsets.at(stop); } // first candidate of a stop
+    const int *End(int stop) const { return neighbors.constData() + offsets.at(stop + 1); } // behind the last candidate of a stop
+    int Count(int stop) const { return offsets.at(stop + 1) - offsets.at(stop); } // number of candidates of a stop
+private:
+    QVector<int> offsets; // candidates of stop i are neighbors[offsets[i], offsets[i+1])
+    QVector<int> neighbors;
+    QVector<int> foundNeighbors; // builds: up to k candidates of every stop with a fixed stride (kept for the next build)
+    QVector<int> foundCount; // builds: number of candidates found for every stop
+    SpatialIndex nearestIndex; // builds: the stops that can become nearest neighbor candidates
+};
+
+#endif // CANDIDATENEIGHBORS_H
@@ -0,0 +1,251 @@
+#include "delaunaytriangulation.h"
+#include "parallelsort.h"
+
+#include <QPair>
+#include <deque>
+#include <vector>
+
+static const int parallelMinimum = 4096; // smallest half that is triangulated by a thread of its own
+
+namespace {
+
+// Quarter of a quad edge: the primal edge in both directions and its dual edge in both directions
+struct Quad {
+    Quad *rot; // the same edge rotated by 90 degrees
+    Quad *o; // next edge counterclockwise around the origin
+    int p; // origin point (-1 for dual edges and deleted edges)
+    Quad *&r() { return rot->rot; } // the same edge in the opposite direction
+    int &F() { return r()->p; } // destination point
+    Quad *prev() { return rot->o->rot; } // next edge clockwise around the origin
+    Quad *next() { return r()->prev(); } // next edge counterclockwise around the left face
+};
+
+// Memory of the edges that one thread creates; the addresses stay valid while it grows
+struct Arena {
+    struct Edge { Quad quarter[4]; };
+    std::deque<Edge> edges;
+    Quad *free = nullptr; // deleted edges, linked through o
+};
+
+// Point with its position, ordered by x, then y, then id
+struct SortedPoint {
+    double x, y;
+    int id;
+    bool operator<(const SortedPoint &other) const {
+        return x < other.x || (x == other.x && (y < other.y || (y == other.y && id < other.id)));
+    }
+};
+
+// Divide and conquer over the points sorted by x (then y), all positions distinct
+class Triangulator
+{
+public:
+    Triangulator(const double *x, const double *y): x(x), y(y) {}
+    QPair<Quad*, Quad*> Triangulate(int begin, int end, int depth, Arena *arenas, int arena);
+private:
+    const double *x, *y; // coordinates of the sorted points
+    double Cross(int p, int a, int b) const { // > 0 if p, a, b turn counterclockwise
+        return (x[a] - x[p]) * (y[b] - y[p]) - (y[a] - y[p]) * (x[b] - x[p]);
+    }
+    bool InCircle(int p, int a, int b, int c) const; // true if p is inside the circle through a, b, c (counterclockwise)
+    Quad *MakeEdge(Arena &arena, int origin, int destination) const;
+    void Splice(Quad *a, Quad *b) const;
+    Quad *Connect(Arena &arena, Quad *a, Quad *b) const;
+    bool Valid(Quad *e, Quad *base) const { return Cross(e->F(), base->F(), base->p) > 0; } // e lies above the base edge
+};
+
+bool Triangulator::InCircle(int p, int a, int b, int c) const{
+    double ax = x[a] - x[p], ay = y[a] - y[p];
+    double bx = x[b] - x[p], by = y[b] - y[p];
+    double cx = x[c] - x[p], cy = y[c] - y[p];
+    return (ax * by - ay * bx) * (cx * cx + cy * cy) + (bx * cy - by * cx) * (ax * ax + ay * ay) +
+           (cx * ay - cy * ax) * (bx * bx + by * by) > 0;
+}
+
+Quad *Triangulator::MakeEdge(Arena &arena, int origin, int destination) const{
+    Quad *e = arena.free;
+    if(e){
+        arena.free = e->o;
+    }else{
+        arena.edges.emplace_back();
+        Quad *quarter = arena.edges.back().quarter;
+        for(int i = 0; i < 4; i++)
+            quarter[i].rot = &quarter[(i + 1) % 4];
+        e = quarter;
+    }
+    // A new edge is alone: the primal quarters point to themselves, the dual ones to each other
+    for(int i = 0; i < 4; i++){
+        e = e->rot;
+        e->p = -1;
+        e->o = i & 1 ? e : e->r();
+    }
+    e->p = origin;
+    e->F() = destination;
+    return e;
+}
+
+void Triangulator::Splice(Quad *a, Quad *b) const{
+    std::swap(a->o->rot->o, b->o->rot->o);
+    std::swap(a->o, b->o);
+}
+
+// New edge from the destination of a to the origin of b
+Quad *Triangulator::Connect(Arena &arena, Quad *a, Quad *b) const{
+    Quad *e = MakeEdge(arena, a->F(), b->p);
+    Splice(e, a->next());
+    Splice(e->r(), b);
+    return e;
+}
+
+// Triangulates the points [begin, end) and returns the counterclockwise convex hull edge out of the
+// leftmost point and the clockwise one out of the rightmost point
+QPair<Quad*, Quad*> Triangulator::Triangulate(int begin, int end, int depth, Arena *arenas, int arena){
+    Arena &memory = arenas[arena];
+    if(end - begin == 2){
+        Quad *a = MakeEdge(memory, begin, begin + 1);
+        return qMakePair(a, a->r());
+    }
+    if(end - begin == 3){
+        Quad *a = MakeEdge(memory, begin, begin + 1);
+        Quad *b = MakeEdge(memory, begin + 1, begin + 2);
+        Splice(a->r(), b);
+        double side = Cross(begin, begin + 1, begin + 2);
+        Quad *c = side != 0 ? Connect(memory, b, a) : nullptr;
+        return qMakePair(side < 0 ? c->r() : a, side < 0 ? c : b->r());
+    }
+
+    // The halves of the upper levels run in parallel, each in its own arena
+    int middle = begin + (end - begin) / 2;
+    QPair<Quad*, Quad*> left, right;
+    if(depth > 0 && middle - begin >= parallelMinimum){
+        ParallelFor(2, 2, [&](int first, int last, int){
+            for(int half = first; half < last; half++){
+                if(half == 0)
+                    left = Triangulate(begin, middle, depth - 1, arenas, arena);
+                else
+                    right = Triangulate(middle, end, depth - 1, arenas, arena + (1 << (depth - 1)));
+            }
+        });
+    }else{
+        left = Triangulate(begin, middle, 0, arenas, arena);
+        right = Triangulate(middle, end, 0, arenas, arena);
+    }
+    Quad *leftOuter = left.first, *leftInner = left.second;
+    Quad *rightInner = right.first, *rightOuter = right.second;
+
+    // Lower common tangent of both halves
+    while(true){
+        if(Cross(rightInner->p, leftInner->F(), leftInner->p) < 0)
+            leftInner = leftInner->next();
+        else if(Cross(leftInner->p, rightInner->F(), rightInner->p) > 0)
+            rightInner = rightInner->r()->o;
+        else
+            break;
+    }
+    Quad *base = Connect(memory, rightInner->r(), leftInner);
+    if(leftInner->p == leftOuter->p)
+        leftOuter = base->r();
+    if(rightInner->p == rightOuter->p)
+        rightOuter = base;
+
+    // Zip the halves together upwards; edges whose circle would hold the next candidate are deleted
+    while(true){
+        Quad *leftCandidate = base->r()->o;
+        if(Valid(leftCandidate, base)){
+            while(InCircle(leftCandidate->o->F(), base->F(), base->p, leftCandidate->F())){
+                Quad *next = leftCandidate->o;
+                Splice(leftCandidate, leftCandidate->prev());
+                Splice(leftCandidate->r(), leftCandidate->r()->prev());
+                leftCandidate->p = -1; leftCandidate->F() = -1;
+                leftCandidate->o = memory.free; memory.free = leftCandidate;
+                leftCandidate = next;
+            }
+        }
+        Quad *rightCandidate = base->prev();
+        if(Valid(rightCandidate, base)){
+            while(InCircle(rightCandidate->prev()->F(), base->F(), base->p, rightCandidate->F())){
+                Quad *next = rightCandidate->prev();
+                Splice(rightCandidate, rightCandidate->prev());
+                Splice(rightCandidate->r(), rightCandidate->r()->prev());
+                rightCandidate->p = -1; rightCandidate->F() = -1;
+                rightCandidate->o = memory.free; memory.free = rightCandidate;
+                rightCandidate = next;
+            }
+        }
+        bool leftValid = Valid(leftCandidate, base), rightValid = Valid(rightCandidate, base);
+        if(!leftValid && !rightValid)
+            break;
+        if(!leftValid || (rightValid && InCircle(rightCandidate->F(), rightCandidate->p, leftCandidate->F(), leftCandidate->p)))
+            base = Connect(memory, rightCandidate, base->r());
+        else
+            base = Connect(memory, base->r(), leftCandidate->r());
+    }
+    return qMakePair(leftOuter, rightOuter);
+}
+
+}
+
+DelaunayTriangulation::DelaunayTriangulation()
+{
+
+}
+
+// Sorts the points, drops repeated positions, triangulates and collects the edges of every point
+void DelaunayTriangulation::Build(const QVector<double> &x, const QVector<double> &y, const QVector<int> &points, int threadCount){
+    int count = x.count();
+    QVector<SortedPoint> order(points.count());
+    for(int i = 0; i < points.count(); i++){
+        order[i].x = x.at(points.at(i));
+        order[i].y = y.at(points.at(i));
+        order[i].id = points.at(i);
+    }
+    ParallelSort(order, threadCount);
+
+    // Distinct positions in sorted order; a repeated position is linked to the point before it
+    QVector<double> sortedX, sortedY;
+    QVector<int> sortedId;
+    QVector<int> edges; // point pairs
+    for(int i = 0; i < order.count(); i++){
+        const SortedPoint &point = order.at(i);
+        if(i > 0 && point.x == order.at(i - 1).x && point.y == order.at(i - 1).y){
+            edges << point.id << order.at(i - 1).id;
+            continue;
+        }
+        sortedX.append(point.x);
+        sortedY.append(point.y);
+        sortedId.append(point.id);
+    }
+
+    int distinct = sortedId.count();
+    if(distinct >= 2){
+        int depth = 0;
+        int threads = ParallelThreadCount(threadCount);
+        while((1 << depth) < threads)
+            depth++;
+        std::vector<Arena> arenas(1 << depth);
+        Triangulator triangulator(sortedX.constData(), sortedY.constData());
+        triangulator.Triangulate(0, distinct, depth, arenas.data(), 0);
+
+        // Deleted edges have no points any more
+        for(const Arena &arena : arenas){
+            for(const Arena::Edge &edge : arena.edges){
+                int origin = edge.quarter[0].p, destination = edge.quarter[2].p;
+                if(origin >= 0 && destination >= 0)
+                    edges << sortedId.at(origin) << sortedId.at(destination);
+            }
+        }
+    }
+
+    // Both directions of every edge, grouped by point
+    offsets.fill(0, count + 1);
+    for(int point : edges)
+        offsets[point + 1]++;
+    for(int i = 0; i < count; i++)
+        offsets[i + 1] += offsets.at(i);
+    QVector<int> filled = offsets;
+    neighbors.resize(edges.count());
+    for(int i = 0; i < edges.count(); i += 2){
+        neighbors[filled[edges.at(i)]++] = edges.at(i + 1);
+        neighbors[filled[edges.at(i + 1)]++] = edges.at(i);
+    }
+}
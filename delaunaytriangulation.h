@@ -0,0 +1,26 @@
+#ifndef DELAUNAYTRIANGULATION_H
+#define DELAUNAYTRIANGULATION_H
+
+#include <QVector>
+
+// Delaunay triangulation of a set of points by Guibas-Stolfi divide and conquer on quad edges, O(n log n).
+// The points are sorted by x, both halves are triangulated recursively (in parallel on the upper levels)
+// and then zipped together from the lower common tangent upwards. The result is kept as the list of
+// Delaunay neighbors of every point; it contains the nearest neighbor and the minimum spanning tree edges
+// of every point. Points at the same position are chained to each other; only the first of them is triangulated.
+class DelaunayTriangulation
+{
+public:
+    DelaunayTriangulation();
+    // Triangulates the given points (ids are indices into x and y, other ids get no neighbors)
+    void Build(const QVector<double> &x, const QVector<double> &y, const QVector<int> &points, int threadCount = 0);
+    const int *Begin(int point) const { return neighbors.constData() + offsets.at(point); } // first neighbor of a point
+    const int *End(int point) const { return neighbors.constData() + offsets.at(point + 1); } // behind the last neighbor of a point
+    int Count(int point) const { return offsets.at(point + 1) - offsets.at(point); } // number of neighbors of a point
+    int EdgeCount() const { return neighbors.count() / 2; } // number of edges
+private:
+    QVector<int> offsets; // neighbors of point i are neighbors[offsets[i], offsets[i+1])
+    QVector<int> neighbors;
+};
+
+#endif // DELAUNAYTRIANGULATION_H
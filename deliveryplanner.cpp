@@ -1,87 +1,1013 @@
 #include "deliveryplanner.h"
+#include "twoopt.h"
+#include "oropt.h"
+#include "linkernighan.h"
+#include "parallelfor.h"
+#include "savingsconstruction.h"
+#include "routeexchange.h"
+#include "pickupdeliverysearch.h"
+#include "insertionsearch.h"
+#include "heldkarp.h"
+#include "onetreebound.h"
+#include "spacefillingcurve.h"
+#include "greedyedgeconstruction.h"
+
+#include <algorithm>
+
+static const int progressInterval = 4096; // stops of the nearest neighbor construction between two progress reports
+
+// Stages that draw random numbers: each gets its own generator split from the seed, and splits it again
+// per start, cluster or route, so no stage changes the numbers of another
+enum RandomStage{
+    multiStartRandom, // first stops of the multi-start construction
+    tourRandom, // kicks of the single vehicle tour
+    clusterRandom, // kicks of the cluster tours of a decomposition
+    fleetRandom // kicks of the vehicle routes
+};
 
 DeliveryPlanner::DeliveryPlanner():
+    plannedLength(0),
+    insertionDistance(stops.x, stops.y),
+    insertionSearch(insertionDistance, stops.x, stops.y),
+    insertionReady(false),
+    stopsAppended(false),
     deliveryCount(0),
-    pickupCount(0)
+    pickupCount(0),
+    requestCount(0),
+    candidateCount(8),
+    candidateGraph(nearestCandidates),
+    bruteForceLimit(1024),
+    matrixLimit(0),
+    matrixMemoryCap(256 * 1024 * 1024),
+    decompositionLimit(0),
+    decompositionClusters(0),
+    exactLimit(0),
+    vehicleCount(1),
+    vehicleCapacity(0),
+    fleetFeasible(true),
+    fleetIgnored(false),
+    travelSpeed(1),
+    timeWindows(false),
+    constructionMethod(nearestNeighborConstruction),
+    improvementStage(twoOptImprovement),
+    threadCount(0),
+    scheduler(nullptr),
+    startCount(1),
+    seed(1),
+    cancelled(false),
+    streamInterval(100)
 {
     xDepot.append(0); yDepot.append(0); // Add the depot point x/y=0/0
+    improvementBudget.stop = &cancelled;
 }
 
-// Nearest neighbor algorithm: Calculates the planned route
+// Calculates the planned routes: a single tour (nearest neighbor construction followed by the improvement
+// stage) or, if a fleet is set up, one route per vehicle from the savings construction
 double DeliveryPlanner::CalculateDeliveryPlan(){
-    // Initialize the eventList with all points
-    FillEventList();
+    TaskScheduler::Scope scope(Scheduler());
+    // Initialize the stop store with all points
+    FillStopStore();
+
+    // Clear the route from previous runtimes
+    plannedRoutes.clear();
+    insertionReady = false;
+    decomposition = DecompositionReport();
+    fleetFeasible = true;
+    xPlanned.clear(); yPlanned.clear();
+    xRoutes.clear(); yRoutes.clear();
+
+    // Precompute all distances if the instance is small enough, otherwise every stage computes them on the fly
+    if(DistanceMatrixMemory() > 0)
+        distanceMatrix.Build(stops.x, stops.y, threadCount);
+    else
+        distanceMatrix.Clear();
+
+    // Requests are only planned on a single tour: the fleet settings and the windows are left out then
+    bool constrained = vehicleCount > 1 || vehicleCapacity > 0 || timeWindows;
+    bool fleet = requestCount == 0 && constrained;
+    fleetIgnored = requestCount > 0 && constrained;
+    double length = fleet ? CalculateFleetPlan() : CalculateTourPlan();
+    plannedLength = length;
+
+    // prepare the planned routes that we found so that we can plot them
+    FillPlannedRoute();
+    PublishPlan();
+    int placedStops = 0;
+    for(const QVector<int> &route : plannedRoutes)
+        placedStops += route.count() - 2;
+    ReportProgress(placedStops, length);
+
+    // Return the distance of our routes
+    return length;
+
+}
+
+// Runs every construction on the current points, without the improvement stage and the pickup point, and
+// reports the length and the runtime of its tour; LastConstructions() keeps the reports. A cancel ends the
+// comparison after the running construction, the reports of the finished ones are kept. Right after a plan
+// the planned routes are kept. If points were added since, the stops are numbered again, which drops the
+// planned routes: the next inserted point is only added, and the lower bound needs a new plan.
+QVector<ConstructionReport> DeliveryPlanner::CompareConstructions(){
+    TaskScheduler::Scope scope(Scheduler());
+    if(stopsAppended || stops.Count() != 1 + xDelivery.count() + xPickup.count() + 2 * requestCount){
+        FillStopStore();
+        plannedRoutes.clear();
+        plannedLength = 0;
+        insertionReady = false;
+        if(DistanceMatrixMemory() > 0)
+            distanceMatrix.Build(stops.x, stops.y, threadCount);
+        else
+            distanceMatrix.Clear();
+    }
+
+    QVector<ConstructionReport> reports;
+    QVector<ConstructionMethod> methods;
+    methods << nearestNeighborConstruction << spaceFillingCurveConstruction << greedyEdgeConstruction;
+    for(ConstructionMethod method : methods){
+        if(cancelled)
+            break;
+        QElapsedTimer timer;
+        timer.start();
+        QVector<int> route;
+        ConstructTour(method, route);
+        ConstructionReport report;
+        report.method = method;
+        report.milliseconds = timer.elapsed();
+        report.length = Distance().RouteLength(route);
+        reports.append(report);
+    }
+    constructions = reports;
+    return reports;
+}
+
+// Certified lower bound of the shortest plan for the points of the last calculated plan: the Held-Karp
+// 1-tree bound of the tour through the depot, the delivery points and the requests. It holds for the
+// vehicle routes as well (together they can be shortened into one tour) and ignores the capacity, the
+// time windows and the pickup point, which only make plans longer. The budget limits the subgradient
+// iterations; more iterations give a tighter bound. The default budget has no time limit, so the bound
+// does not depend on the speed of the machine.
+double DeliveryPlanner::CalculateLowerBound(ImprovementBudget budget){
+    if(plannedRoutes.isEmpty())
+        return 0;
+    TaskScheduler::Scope scope(Scheduler());
+    budget.stop = &cancelled;
+    DistanceFunction distance = Distance();
+    double planLength = 0;
+    for(const QVector<int> &route : plannedRoutes)
+        planLength += distance.RouteLength(route);
+
+    QVector<int> tourStops;
+    for(int i = 1; i < stops.Count(); i++){
+        if(stops.kind.at(i) != pickupStop)
+            tourStops.append(i);
+    }
+    OneTreeBound bound(stops, threadCount);
+    return bound.Compute(tourStops, planLength, budget, candidateCount);
+}
+
+// Single vehicle without capacity: one closed tour through all delivery points and all requests (every
+// pickup before its delivery); the pickup point that is cheapest to add is inserted into the finished tour
+double DeliveryPlanner::CalculateTourPlan(){
+    // Small tours are solved exactly if the exact solver is enabled for them
+    int tourStops = stops.Count() - 1 - (int)pickupCount + (pickupCount > 0 ? 1 : 0);
+    if(exactLimit > 0 && tourStops <= exactLimit)
+        return CalculateExactTourPlan();
+    if(decompositionLimit > 0 && requestCount == 0 && tourStops >= decompositionLimit)
+        return CalculateDecomposedTourPlan();
+
+    QVector<int> route; // stop indices in the order they are visited
+    ConstructTour(constructionMethod, route);
+    DistanceFunction distance = Distance();
+    double constructedLength = distance.RouteLength(route);
+    ReportProgress(route.count() - 1, constructedLength);
+    PublishTour(route, constructedLength);
+
+    // The candidate lists and the work arrays of the stages keep their memory for the next plan
+    CandidateNeighbors &candidates = tourCandidates;
+    if(improvementStage != noImprovement)
+        BuildCandidates(candidates, route, candidateCount);
+    double length;
+    if(requestCount > 0 && improvementStage != noImprovement){
+        // The improvement stages reverse parts of the route, which would turn requests around
+        PickupDeliverySearch search(distance, candidates, stops, improvementBudget);
+        length = search.Optimize(route);
+        Q_ASSERT(PickupDeliverySearch::PrecedenceKept(route, stops));
+    }else{
+        // The receiver sees the tour get shorter while the stages run
+        RouteStream stream([this](const QVector<int> &tour, double tourLength){ PublishTour(tour, tourLength); }, streamInterval);
+        length = ImproveRoute(distance, route, candidates, improvementBudget, Random(tourRandom), Scratch(1), tourReceiver ? &stream : nullptr);
+    }
+
+    // The first and the last point of our route is the depot
+    route.push_back(route.at(0));
+    plannedRoutes.append(route);
+    return length + InsertPickup(plannedRoutes, nullptr);
+}
+
+// Constructs the tour through the depot, the delivery points and the requests with the given method
+void DeliveryPlanner::ConstructTour(ConstructionMethod method, QVector<int> &route){
+    switch(method){
+        case nearestNeighborConstruction:
+            // The index holds the stops that are not part of the route yet. Small instances scan all remaining
+            // stops with the vectorized kernel, larger ones use the k-d tree.
+            if(stops.Count() <= bruteForceLimit){
+                bruteForceIndex.Build(stops.x, stops.y);
+                ConstructRoute(bruteForceIndex, route);
+            }else{
+                spatialIndex.Build(stops.x, stops.y);
+                ConstructRoute(spatialIndex, route);
+            }
+            break;
+        case spaceFillingCurveConstruction: ConstructCurveRoute(route); break;
+        case greedyEdgeConstruction: ConstructGreedyRoute(route); break;
+    }
+}
+
+// Space-filling-curve construction over the depot, the delivery points and the requests
+void DeliveryPlanner::ConstructCurveRoute(QVector<int> &route) const{
+    QVector<int> tourStops;
+    tourStops.reserve(stops.Count());
+    for(int i = 0; i < stops.Count(); i++){
+        if(stops.kind.at(i) != pickupStop)
+            tourStops.append(i);
+    }
+    SpaceFillingCurve curve(stops.x, stops.y, threadCount);
+    curve.Construct(tourStops, route);
+    KeepPrecedence(route);
+}
+
+// Greedy edge construction over the depot, the delivery points and the requests. The candidate list is
+// longer than for the improvement, which leaves fewer paths to join.
+void DeliveryPlanner::ConstructGreedyRoute(QVector<int> &route) const{
+    QVector<int> tourStops;
+    tourStops.reserve(stops.Count());
+    for(int i = 0; i < stops.Count(); i++){
+        if(stops.kind.at(i) != pickupStop)
+            tourStops.append(i);
+    }
+    DistanceFunction distance = Distance();
+    CandidateNeighbors candidates;
+    BuildCandidates(candidates, tourStops, candidateCount + 2);
+    GreedyEdgeConstruction greedy(distance, candidates, threadCount);
+    greedy.Construct(tourStops, route);
+    KeepPrecedence(route);
+}
+
+// Constructions that do not know the requests can visit a delivery before its pickup. The direction with
+// fewer such deliveries is kept, and these deliveries are made on a second lap after all other stops.
+void DeliveryPlanner::KeepPrecedence(QVector<int> &route) const{
+    if(requestCount == 0)
+        return;
+
+    QVector<int> position(stops.Count(), -1);
+    for(int i = 0; i < route.count(); i++)
+        position[route.at(i)] = i;
+    int late = 0;
+    for(int i = 0; i < requestCount; i++){
+        int pickup = FirstRequestStop() + 2 * i;
+        if(position.at(pickup + 1) < position.at(pickup))
+            late++;
+    }
+    if(2 * late > requestCount)
+        std::reverse(route.begin() + 1, route.end());
+
+    QVector<bool> visited(stops.Count(), false);
+    QVector<int> secondLap;
+    int kept = 0;
+    for(int stop : route){
+        if(stops.kind.at(stop) == requestDeliveryStop && !visited.at(stops.partner.at(stop))){
+            secondLap.append(stop);
+            continue;
+        }
+        visited[stop] = true;
+        route[kept++] = stop;
+    }
+    for(int stop : secondLap)
+        route[kept++] = stop;
+    Q_ASSERT(PickupDeliverySearch::PrecedenceKept(route, stops));
+}
+
+// Exact tour: Held-Karp finds the shortest tour through all delivery points and requests. Under the pickup
+// rule it runs once with every pickup point and keeps the shortest tour (the first pickup point on ties).
+double DeliveryPlanner::CalculateExactTourPlan(){
+    DistanceFunction distance = Distance();
+    HeldKarp heldKarp(distance, stops, threadCount);
+    QVector<int> tourStops;
+    for(int i = 1; i < stops.Count(); i++){
+        if(stops.kind.at(i) != pickupStop)
+            tourStops.append(i);
+    }
+
+    QVector<int> route;
+    double length = pickupCount == 0 ? heldKarp.Solve(tourStops, route) : 0;
+    for(uint i = 0; i < pickupCount; i++){
+        QVector<int> pickupRoute;
+        double pickupLength = heldKarp.Solve(QVector<int>(tourStops) << 1 + deliveryCount + i, pickupRoute);
+        if(i == 0 || pickupLength < length){
+            length = pickupLength;
+            route.swap(pickupRoute);
+        }
+    }
+
+    // The first and the last point of our route is the depot
+    route.push_back(route.at(0));
+    plannedRoutes.append(route);
+    return length;
+}
+
+// Decomposition: the stops are cut into clusters of consecutive stops along a Hilbert curve, so every
+// cluster is compact and neighbors the next one. The clusters are split between the threads; each gets a
+// greedy edge tour from its share of the candidate lists and the improvement stage. The cluster tours are
+// then linked in curve order: every tour is opened at the edge that makes the way in from the previous
+// cluster and out towards the center of the next one shortest. A 2-opt pass that starts at the seams
+// repairs the links. The clusters and the seam pass share one deadline, so a time limit bounds the whole
+// plan, not every cluster; the iteration limit applies to every cluster on its own. The report keeps the
+// length of the links. It is no measure of what the decomposition costs: compare the plan with
+// CalculateLowerBound() for that.
+double DeliveryPlanner::CalculateDecomposedTourPlan(){
+    DistanceFunction distance = Distance();
+    QVector<int> tourStops;
+    for(int i = 1; i < stops.Count(); i++){
+        if(stops.kind.at(i) != pickupStop)
+            tourStops.append(i);
+    }
+    SpaceFillingCurve curve(stops.x, stops.y, threadCount);
+    QVector<int> order;
+    curve.Sort(tourStops, order);
+
+    // The number of clusters does not depend on the threads, so neither does the tour
+    int clusterCount = qBound(1, decompositionClusters > 0 ? decompositionClusters : order.count() / clusterStops, order.count());
+    QVector<int> group(stops.Count(), -1);
+    QVector<int> local(stops.Count(), -1); // index of every stop in its cluster
+    QVector<QVector<int>> clusters(clusterCount);
+    for(int c = 0; c < clusterCount; c++){
+        int begin = (int)((long long)order.count() * c / clusterCount);
+        int end = (int)((long long)order.count() * (c + 1) / clusterCount);
+        clusters[c] = order.mid(begin, end - begin);
+        for(int i = 0; i < clusters.at(c).count(); i++){
+            group[clusters.at(c).at(i)] = c;
+            local[clusters.at(c).at(i)] = i;
+        }
+    }
+    CandidateNeighbors allCandidates; // candidates across all clusters
+    BuildCandidates(allCandidates, tourStops, candidateCount + 2);
+
+    // Every cluster is planned on its own coordinates, distances and candidates with the stops numbered
+    // 0 .. m - 1, so the arrays of its stages have the size of the cluster and not of all stops
+    QVector<double> clusterLength(clusterCount, 0);
+    double *length = clusterLength.data();
+    QVector<int> *cluster = clusters.data(); // detach once, before the threads write to it
+    SplitRandom random = Random(clusterRandom);
+    BudgetTracker tracker(improvementBudget);
+    ImprovementScratch *scratch = Scratch(ParallelThreadCount(threadCount));
+    ParallelFor(clusterCount, threadCount, [&](int begin, int end, int worker){
+        for(int c = begin; c < end; c++){
+            int count = cluster[c].count();
+            QVector<double> x(count), y(count);
+            QVector<int> localStops(count);
+            for(int i = 0; i < count; i++){
+                x[i] = stops.x.at(cluster[c].at(i));
+                y[i] = stops.y.at(cluster[c].at(i));
+                localStops[i] = i;
+            }
+            DistanceFunction clusterDistance(x, y);
+            CandidateNeighbors candidates;
+            candidates.BuildLocal(allCandidates, cluster[c], group, local, candidateCount + 2);
+            GreedyEdgeConstruction greedy(clusterDistance, candidates, 1);
+            QVector<int> route;
+            greedy.Construct(localStops, route);
+            length[c] = ImproveRoute(clusterDistance, route, candidates, tracker.Remaining(), random.Split(c), &scratch[worker]);
+            for(int &stop : route)
+                stop = cluster[c].at(stop);
+            cluster[c].swap(route);
+        }
+    });
+
+    // Link the cluster tours, the depot comes first and last
+    decomposition.linkLength = 0;
+    QVector<int> route;
+    route.reserve(order.count() + 1);
+    route.append(0);
+    QVector<int> seams;
+    for(int c = 0; c < clusterCount; c++){
+        const QVector<int> &tour = clusters.at(c);
+        int count = tour.count();
+        if(count == 0)
+            continue;
+        int previous = route.last();
+        double nextX = stops.x.at(0), nextY = stops.y.at(0);
+        if(c + 1 < clusterCount){
+            const QVector<int> &next = clusters.at(c + 1);
+            nextX = 0; nextY = 0;
+            for(int stop : next){
+                nextX += stops.x.at(stop) / next.count();
+                nextY += stops.y.at(stop) / next.count();
+            }
+        }
+        auto toNext = [&](int stop){
+            return sqrt((stops.x.at(stop) - nextX) * (stops.x.at(stop) - nextX) + (stops.y.at(stop) - nextY) * (stops.y.at(stop) - nextY));
+        };
+        // Opening the edge (tour[i], tour[i + 1]): enter at one end, leave at the other
+        int bestEdge = 0;
+        bool bestForward = true;
+        double bestCost = 0;
+        for(int i = 0; i < count; i++){
+            int a = tour.at(i), b = tour.at((i + 1) % count);
+            double forward = distance(previous, b) - distance(a, b) + toNext(a);
+            double backward = distance(previous, a) - distance(a, b) + toNext(b);
+            if(i == 0 || forward < bestCost){
+                bestCost = forward; bestEdge = i; bestForward = true;
+            }
+            if(backward < bestCost){
+                bestCost = backward; bestEdge = i; bestForward = false;
+            }
+        }
+        seams.append(previous);
+        decomposition.linkLength += distance(previous, tour.at(bestForward ? (bestEdge + 1) % count : bestEdge));
+        for(int j = 1; j <= count; j++){
+            int position = bestForward ? (bestEdge + j) % count : ((bestEdge + 1 - j) % count + count) % count;
+            route.append(tour.at(position));
+        }
+        seams.append(route.at(route.count() - count));
+    }
+    seams.append(route.last());
+    decomposition.linkLength += distance(route.last(), 0);
+
+    decomposition.clusters = clusterCount;
+    decomposition.clusterLength = 0;
+    for(double value : clusterLength)
+        decomposition.clusterLength += value;
+    if(improvementStage != noImprovement){
+        TwoOpt twoOpt(distance, allCandidates, tracker.Remaining());
+        twoOpt.Optimize(route, &seams);
+        std::rotate(route.begin(), std::find(route.begin(), route.end(), 0), route.end());
+    }
+    decomposition.length = distance.RouteLength(route);
+
+    // The first and the last point of our route is the depot
+    route.push_back(route.at(0));
+    plannedRoutes.append(route);
+    return decomposition.length + InsertPickup(plannedRoutes, nullptr);
+}
+
+// Fleet: the savings construction routes the delivery points into at most one route per vehicle within
+// the vehicle capacity and the time windows (if it cannot, the plan is marked infeasible), then the pickup
+// point with the cheapest insertion is added and the routes are improved
+double DeliveryPlanner::CalculateFleetPlan(){
+    DistanceFunction distance = Distance();
+    QVector<int> deliveries;
+    for(uint i = 1; i <= deliveryCount; i++)
+        deliveries.append(i);
+    TimeWindowSchedule schedule(distance, stops, travelSpeed);
+
+    // Savings are only computed between near stops; a longer list than for the improvement keeps
+    // the joins close to those of the full savings list
+    CandidateNeighbors savingsCandidates;
+    BuildCandidates(savingsCandidates, deliveries, 2 * candidateCount);
+    SavingsConstruction savings(distance, savingsCandidates, stops.demand, vehicleCapacity, timeWindows ? &schedule : nullptr,
+                                vehicleCount);
+    savings.Construct(deliveries, plannedRoutes);
+    fleetFeasible = plannedRoutes.count() <= vehicleCount;
+    double savingsLength = 0;
+    for(const QVector<int> &route : plannedRoutes)
+        savingsLength += distance.RouteLength(route);
+    ReportProgress(deliveries.count(), savingsLength);
+    schedule.Build(plannedRoutes);
+    InsertPickup(plannedRoutes, &schedule);
+    return ImproveRoutes(plannedRoutes, schedule);
+}
+
+// Pickup rule: exactly one pickup point is visited. Every pickup point is tried at its cheapest position
+// in the finished routes (the pickup points are split between the threads) and the one that adds the
+// least length is inserted. With time windows, insertions that keep the windows are preferred; if no
+// insertion keeps them, the cheapest one is taken anyway. Ties go to the lowest pickup, route and
+// position. Returns the added length.
+double DeliveryPlanner::InsertPickup(QVector<QVector<int>> &routes, TimeWindowSchedule *schedule){
+    if(pickupCount == 0)
+        return 0;
+    // The pickup points follow the delivery points only in a freshly filled stop store
+    Q_ASSERT(!stopsAppended);
+    // Without other stops the pickup point gets a route of its own
+    if(routes.isEmpty()){
+        routes.append(QVector<int>() << 0 << 0);
+        if(schedule)
+            schedule->Build(routes);
+    }
+
+    struct Candidate {
+        int pickup;
+        InsertionSearch::Insertion insertion;
+        bool feasible;
+        bool operator<(const Candidate &other) const { // true if this candidate is preferred
+            if(feasible != other.feasible)
+                return feasible;
+            return insertion.increase < other.insertion.increase;
+        }
+    };
+    DistanceFunction distance = Distance();
+    const QVector<QVector<int>> &finished = routes;
+    bool checkWindows = schedule && timeWindows;
+    // The planner's insertion search keeps its memory; it is built again before the next inserted point
+    InsertionSearch &search = insertionSearch;
+    insertionDistance = distance;
+    insertionReady = false;
+    if(!checkWindows)
+        search.Build(finished);
+
+    int threads = ParallelThreadCount(threadCount);
+    QVector<Candidate> workerBest(threads);
+    for(Candidate &candidate : workerBest)
+        candidate.pickup = -1;
+    ParallelFor(pickupCount, threadCount, [&](int begin, int end, int worker){
+        Candidate best;
+        best.pickup = -1;
+        for(int i = begin; i < end; i++){
+            Candidate candidate;
+            candidate.pickup = deliveryCount + 1 + i;
+            if(!checkWindows){
+                candidate.insertion = search.Cheapest(candidate.pickup);
+                candidate.feasible = true;
+                if(best.pickup < 0 || candidate < best)
+                    best = candidate;
+                continue;
+            }
+            // The windows of an insertion depend on its position, so every edge is checked
+            for(int r = 0; r < finished.count(); r++){
+                const int *route = finished.at(r).constData();
+                for(int position = 1; position < finished.at(r).count(); position++){
+                    candidate.insertion.route = r;
+                    candidate.insertion.position = position;
+                    candidate.insertion.increase = distance(route[position - 1], candidate.pickup) + distance(candidate.pickup, route[position])
+                                                 - distance(route[position - 1], route[position]);
+                    candidate.feasible = schedule->CanInsert(r, position, candidate.pickup);
+                    if(best.pickup < 0 || candidate < best)
+                        best = candidate;
+                }
+            }
+        }
+        workerBest[worker] = best;
+    });
+
+    // Workers hold ascending pickup ranges, so a strict comparison keeps the lowest pickup on ties
+    Candidate best = workerBest.at(0);
+    for(const Candidate &candidate : workerBest){
+        if(candidate.pickup >= 0 && candidate < best)
+            best = candidate;
+    }
+    routes[best.insertion.route].insert(best.insertion.position, best.pickup);
+    if(schedule)
+        schedule->Update(routes, best.insertion.route);
+    return best.insertion.increase;
+}
+
+// Improves the routes (depot at both ends): first with moves between the routes, then, without time
+// windows, every route on its own in parallel with candidates on the same route. The stages share the
+// budget. Returns the total length.
+double DeliveryPlanner::ImproveRoutes(QVector<QVector<int>> &routes, TimeWindowSchedule &schedule){
+    DistanceFunction distance = Distance();
+    if(improvementStage == noImprovement){
+        double length = 0;
+        for(const QVector<int> &route : routes)
+            length += distance.RouteLength(route);
+        return length;
+    }
+
+    QVector<int> routed;
+    for(const QVector<int> &route : routes)
+        routed += route.mid(1, route.count() - 2);
+    CandidateNeighbors &allCandidates = fleetCandidates; // candidates across all routes
+    BuildCandidates(allCandidates, routed, 2 * candidateCount);
 
-    int eventsPlanned = 0; // Planned events so far
-    int closestEvent = 0; // Next closest event index
-    int remainingEvents = 1 + deliveryCount + pickupCount; // number of remaining events to be added
+    BudgetTracker tracker(improvementBudget);
+    RouteExchange exchange(distance, allCandidates, schedule, stops.demand, vehicleCapacity, tracker.Remaining());
+    double exchangedLength = exchange.Optimize(routes);
+    tracker.CountIterations(exchange.Iterations());
+    // The single route stages reverse parts of a route, which cannot be checked against the windows in O(1)
+    if(timeWindows)
+        return exchangedLength;
 
-    double distClosestEvent = INT_MAX; // Initialize distance to nearest neighbor with large number
+    QVector<int> group(stops.Count(), -1); // route of every stop, -1 for the depot and unvisited stops
+    for(int r = 0; r < routes.count(); r++){
+        for(int i = 1; i + 1 < routes.at(r).count(); i++)
+            group[routes.at(r).at(i)] = r;
+    }
+    CandidateNeighbors &candidates = routeCandidates;
+    candidates.BuildGrouped(allCandidates, group, candidateCount);
+
+    QVector<double> routeLength(routes.count(), 0);
+    double *length = routeLength.data();
+    QVector<int> *route = routes.data(); // detach once, before the threads write to it
+    SplitRandom random = Random(fleetRandom);
+    ImprovementScratch *scratch = Scratch(ParallelThreadCount(threadCount));
+    ParallelFor(routes.count(), threadCount, [&](int begin, int end, int worker){
+        for(int r = begin; r < end; r++){
+            route[r].removeLast();
+            length[r] = ImproveRoute(distance, route[r], candidates, tracker.Remaining(), random.Split(r), &scratch[worker]);
+            route[r].append(0);
+        }
+    });
+
+    double totalLength = 0;
+    for(double value : routeLength)
+        totalLength += value;
+    return totalLength;
+}
+
+// Runs the nearest neighbor construction once or in multi-start mode on an index that holds all stops
+template<class Index>
+double DeliveryPlanner::ConstructRoute(Index &index, QVector<int> &route) const{
+    int starts = startCount > 0 ? startCount : defaultStarts;
+    if(starts > 1)
+        return ConstructMultiStartRoute(index, starts, route);
+    return ConstructNearestNeighborRoute(index, 0, route, true);
+}
+
+// Nearest neighbor algorithm: Fills route with the stop indices starting at the depot and returns its length.
+// The route goes from the depot to firstStop first (0: start with the nearest neighbor of the depot).
+// index (SpatialIndex or BruteForceIndex) has to contain all stops and is left empty. With report set, the
+// progress is passed on every few thousand stops.
+template<class Index>
+double DeliveryPlanner::ConstructNearestNeighborRoute(Index &index, int firstStop, QVector<int> &route, bool report) const{
+    DistanceFunction distance = Distance();
     double distPlannedSoFar = 0; // Distance of route so far
-    double distCurrent = 0; // holds current distance during runtime
+    route.clear();
 
-    // Clear the eventList from previous runtimes
-    deliveryEventList.clear();
     // First point of the route is the depot at index 0
-    deliveryEventList.push_back(eventList[0]);
-    // Erase that point so that it doesn't get added twice
-    eventList.erase(eventList.begin());
-    remainingEvents--;
-    eventsPlanned++;
-    // While we still have events to add
-    while(remainingEvents > 0)
+    int lastStop = 0;
+    route.push_back(0);
+    // Remove that point so that it doesn't get added twice
+    index.Remove(0);
+    // The pickup point is chosen after the construction
+    for(uint i = 1; i <= pickupCount; i++)
+        index.Remove(deliveryCount + i);
+    // The delivery of a request only becomes available once its pickup is on the route
+    for(int i = 0; i < requestCount; i++)
+        index.Remove(FirstRequestStop() + 2 * i + 1);
+    if(firstStop > 0 && stops.kind[firstStop] == requestDeliveryStop)
+        firstStop = stops.partner[firstStop];
+    // While we still have stops to add: find the nearest neighbor of the last added stop
+    int closestStop = firstStop > 0 ? firstStop : index.Nearest(stops.x[lastStop], stops.y[lastStop]);
+    while(closestStop >= 0)
     {
-        distClosestEvent = INT_MAX;
-        // Find the nearest neighbor of the last added event
-        for (int i = 0; i < remainingEvents; ++i)
-        {
-            distCurrent = eventList[i]->GetDistance(*deliveryEventList[eventsPlanned-1]);
-            if (distCurrent < distClosestEvent)
-            {
-                closestEvent = i; // nearest neighbor index
-                distClosestEvent = distCurrent; // nearest neighbor distance
-            }
-        }
         // Add the nearest neighbor distance
-        distPlannedSoFar += distClosestEvent;
+        distPlannedSoFar += distance(closestStop, lastStop);
         // Add nearest neighbor to our route
-        deliveryEventList.push_back(eventList[closestEvent]);
-
-        // If we found a pickup point we can clear all of the other pickup points
-        // (only visit one (1) pickup pont)
-        if(eventList[closestEvent]->GetIndex() > deliveryCount){
-            eventList.erase(eventList.end() - (pickupCount -1), eventList.end());
-            remainingEvents = remainingEvents - pickupCount;
-        }else{
-            // Otherwise just erase the added event (nearest neighbor)
-            eventList.erase(eventList.begin() + closestEvent);
-            remainingEvents--;
+        route.push_back(closestStop);
+        if(report && route.count() % progressInterval == 0)
+            ReportProgress(route.count() - 1, distPlannedSoFar);
+
+        // Remove the added stop (nearest neighbor)
+        index.Remove(closestStop);
+        if(stops.kind[closestStop] == requestPickupStop)
+            index.Restore(stops.partner[closestStop]);
+        lastStop = closestStop;
+        closestStop = index.Nearest(stops.x[lastStop], stops.y[lastStop]);
+    }
+
+    // The distance between the last added point and the depot has to be considered
+    return distPlannedSoFar + distance(0, lastStop);
+}
+
+// Multi-start construction: builds starts nearest neighbor routes in parallel and keeps the shortest.
+// Start 0 is the plain route from the depot, every other start goes to a random first stop (drawn from
+// the seed and the start number). Ties go to the lower start number, so the winner does not depend on
+// the number of threads.
+template<class Index>
+double DeliveryPlanner::ConstructMultiStartRoute(const Index &prototype, int starts, QVector<int> &route) const{
+    int stopCount = stops.Count() - pickupCount;
+    QVector<double> workerLength(starts, -1);
+    QVector<int> workerStart(starts, -1);
+    QVector<QVector<int>> workerRoute(starts);
+    SplitRandom random = Random(multiStartRandom);
+
+    ParallelFor(starts, threadCount, [&](int begin, int end, int worker){
+        // Every worker removes stops from its own copy of the index
+        Index index = prototype;
+        QVector<int> candidate;
+        for(int start = begin; start < end; start++){
+            // The first stop is drawn among all stops but the depot and the pickup points
+            int firstStop = 0;
+            if(start > 0 && stopCount > 1){
+                firstStop = random.Split(start).Uniform(1, stopCount - 1);
+                if(firstStop > (int)deliveryCount)
+                    firstStop += pickupCount;
+            }
+            index.RestoreAll();
+            double length = ConstructNearestNeighborRoute(index, firstStop, candidate);
+            if(workerStart.at(worker) < 0 || length < workerLength.at(worker)){
+                workerLength[worker] = length;
+                workerStart[worker] = start;
+                workerRoute[worker] = candidate;
+            }
         }
-        // One more event added
-        eventsPlanned++;
+    });
+
+    // Workers hold ascending start ranges, so a strict comparison keeps the lowest start on ties
+    int best = 0;
+    for(int worker = 1; worker < starts; worker++){
+        if(workerStart.at(worker) >= 0 && workerLength.at(worker) < workerLength.at(best))
+            best = worker;
     }
-    // The last point of our route is the depot
-    deliveryEventList.push_back(deliveryEventList.at(0));
+    route = workerRoute.at(best);
+    return workerLength.at(best);
+}
 
-    // prepare the planned route that we found so that we can plot it
-    FillPlannedRoute();
+// Improves a closed route with the selected stage; the route starts at the depot again afterwards
+double DeliveryPlanner::ImproveRoute(const DistanceFunction &distance, QVector<int> &route, const CandidateNeighbors &candidates,
+                                     const ImprovementBudget &budget, const SplitRandom &random, ImprovementScratch *scratch,
+                                     RouteStream *stream) const{
+    if(improvementStage == noImprovement)
+        return distance.RouteLength(route);
+
+    // The stages share the budget: Or-opt gets what 2-opt left over
+    BudgetTracker tracker(budget);
+    double length = 0;
+    if(improvementStage == twoOptImprovement || improvementStage == twoOptOrOptImprovement || improvementStage == linKernighanImprovement){
+        TwoOpt twoOpt(distance, candidates, tracker.Remaining());
+        twoOpt.SetStream(stream);
+        twoOpt.SetScratch(scratch);
+        length = twoOpt.Optimize(route);
+        tracker.CountIterations(twoOpt.Iterations());
+    }
+    if(improvementStage == orOptImprovement || improvementStage == twoOptOrOptImprovement || improvementStage == linKernighanImprovement){
+        OrOpt orOpt(distance, candidates, tracker.Remaining());
+        orOpt.SetStream(stream);
+        orOpt.SetScratch(scratch);
+        length = orOpt.Optimize(route);
+        tracker.CountIterations(orOpt.Iterations());
+    }
+    if(improvementStage == linKernighanImprovement){
+        // Lin-Kernighan counts kicks instead of moves, only the time is shared
+        ImprovementBudget kickBudget(budget.maxIterations, tracker.Remaining().timeLimit, budget.stop);
+        LinKernighan linKernighan(distance, candidates, kickBudget, random);
+        linKernighan.SetStream(stream);
+        linKernighan.SetScratch(scratch);
+        length = linKernighan.Optimize(route);
+    }
+
+    std::rotate(route.begin(), std::find(route.begin(), route.end(), 0), route.end());
+    return length;
+}
+
+// Work arrays of the improvement stages for the given number of workers. The planner keeps them, so the
+// arrays grow to the largest route once and are reused by every later route and plan. Every worker uses
+// its own scratch; the vector only grows here, before the workers start.
+ImprovementScratch *DeliveryPlanner::Scratch(int workers) const{
+    if(improvementScratch.count() < workers)
+        improvementScratch.resize(workers);
+    return improvementScratch.data();
+}
+
+// Selects the improvement stage that runs after the construction and its budget
+void DeliveryPlanner::SetImprovement(ImprovementStage stage, ImprovementBudget budget){
+    improvementStage = stage;
+    improvementBudget = budget;
+    improvementBudget.stop = &cancelled;
+}
+
+// Sets the function that receives the number of stops on the route and its length while a plan is
+// calculated. It is called by the thread that calculates the plan, between the stages and every few
+// thousand stops of the nearest neighbor construction, and once more with the finished plan.
+void DeliveryPlanner::SetProgress(std::function<void(int placedStops, double length)> callback){
+    progress = callback;
+}
+
+// Ends the running calculation as soon as possible: the construction is finished, the improvement stages
+// stop at their next move and keep the route they have reached. The lower bound stops as well. The
+// flag stays set, also for calculations that start later, until ClearCancel().
+void DeliveryPlanner::Cancel(){
+    cancelled = true;
+}
+
+// Clears a cancel. Callers that queue a calculation for another thread clear it when they queue it, not
+// when it starts, so a cancel that comes in between still ends that calculation.
+void DeliveryPlanner::ClearCancel(){
+    cancelled = false;
+}
+
+// Sets the function that receives the coordinates of the single vehicle tour (closed at the depot, without
+// the pickup point) and its length while it is improved: once after the construction and then whenever
+// a stage has improved it, at most once per interval milliseconds. It is called by the thread that
+// calculates the plan. Tours with requests, decomposed tours and fleets are only reported when finished.
+void DeliveryPlanner::SetRouteStream(std::function<void(const QVector<double> &x, const QVector<double> &y, double length)> receiver,
+                                     qint64 interval){
+    tourReceiver = receiver;
+    streamInterval = interval;
+}
+
+// Publishes the coordinates of a tour, starting and ending at the depot, and passes them to the receiver.
+// Nothing is done without a receiver.
+void DeliveryPlanner::PublishTour(const QVector<int> &tour, double length) const{
+    if(!tourReceiver || tour.isEmpty())
+        return;
+    int depot = qMax(0, tour.indexOf(0));
+    QVector<double> x(tour.count() + 1), y(tour.count() + 1);
+    for(int i = 0; i <= tour.count(); i++){
+        int stop = tour.at((depot + i) % tour.count());
+        x[i] = stops.x.at(stop);
+        y[i] = stops.y.at(stop);
+    }
+    plans.Publish(new PlanSnapshot{x, y, length});
+    tourReceiver(x, y, length);
+}
+
+// Publishes the planned route. The snapshot shares the coordinates with xPlanned and yPlanned; the planner
+// detaches them when it changes the plan, so readers on other threads never see a half changed route.
+void DeliveryPlanner::PublishPlan(){
+    plans.Publish(new PlanSnapshot{xPlanned, yPlanned, plannedLength});
+}
 
-    // Return the distance of our route (The distance between the last added point and the depot has to be considered)
-    return distPlannedSoFar + deliveryEventList[0]->GetDistance(*deliveryEventList[eventsPlanned-1]);
+// Passes the progress to the callback, if there is one
+void DeliveryPlanner::ReportProgress(int placedStops, double length) const{
+    if(progress)
+        progress(placedStops, length);
+}
+
+// Selects the construction of the single vehicle tour; the improvement stage runs on its result
+void DeliveryPlanner::SetConstruction(ConstructionMethod method){
+    constructionMethod = method;
+}
+
+// Sets the number of threads of the parallel stages (0: one per core)
+void DeliveryPlanner::SetThreadCount(int count){
+    threadCount = count;
+    // The pool is started again with the new number of threads
+    delete scheduler;
+    scheduler = nullptr;
+}
+
+// All parallel stages of a calculation share one work-stealing pool, so stages that run inside each other
+// (e.g. the cluster tours of a decomposition, which build candidates and sort in parallel themselves) do
+// not start more threads than threadCount. A planner that is called from inside a pool uses that pool.
+TaskScheduler *DeliveryPlanner::Scheduler(){
+    if(TaskScheduler::Current())
+        return nullptr;
+    if(!scheduler)
+        scheduler = new TaskScheduler(threadCount);
+    return scheduler;
+}
+
+// Sets the number of nearest neighbor constructions of which the shortest is kept (1: depot start only,
+// 0: defaultStarts). The number does not depend on the threads, so neither does the winner.
+void DeliveryPlanner::SetMultiStart(int count){
+    startCount = qMax(0, count);
+}
+
+// Sets the seed of the random first stops of the multi-start construction and of the Lin-Kernighan kicks.
+// Every start, cluster and route draws from its own split of the seed, and parallel results are combined
+// in a fixed order, so a seed gives the same plan with any number of threads. Time limits end the stages
+// depending on the speed of the machine; only iteration budgets give the same plan on every run.
+void DeliveryPlanner::SetSeed(quint64 seed){
+    this->seed = seed;
+}
+
+// Precomputes the distances of instances with up to maxStops stops (depot included) as long as the matrix
+// takes at most memoryCap bytes (capped at DistanceMatrix::maxMemory); larger instances compute their distances
+// on the fly
+void DeliveryPlanner::SetDistanceMatrix(int maxStops, qint64 memoryCap){
+    matrixLimit = qMax(0, maxStops);
+    matrixMemoryCap = qMin(memoryCap, DistanceMatrix::maxMemory);
+}
+
+// Bytes the distance matrix of the current points takes, known before the plan is calculated
+// (0 if the distances will be computed on the fly)
+qint64 DeliveryPlanner::DistanceMatrixMemory() const{
+    // The same stops FillStopStore() puts into the stop store
+    int count = 1 + xDelivery.count() + xPickup.count() + 2 * requestCount;
+    qint64 memory = DistanceMatrix::MemoryUsage(count);
+    if(count > matrixLimit || memory > qMin(matrixMemoryCap, DistanceMatrix::maxMemory))
+        return 0;
+    return memory;
+}
+
+// Plans tours with at least minStops stops (depot and pickup points not counted) in clusterCount clusters
+// that are planned in parallel and stitched together (minStops 0: never, clusterCount 0: one per clusterStops stops).
+// Tours with requests are never decomposed. LastDecomposition() reports the clusters and their links.
+void DeliveryPlanner::SetDecomposition(int minStops, int clusterCount){
+    decompositionLimit = qMax(0, minStops);
+    decompositionClusters = qMax(0, clusterCount);
+}
+
+// Solves tours with up to maxStops stops besides the depot exactly instead of constructing and improving
+// them (0: never). The limit is capped at HeldKarp::maxStops; the solver takes HeldKarp::MemoryUsage(maxStops)
+// bytes and its time doubles with every further stop. Fleets and time windows are always planned heuristically.
+void DeliveryPlanner::SetExactSolver(int maxStops){
+    exactLimit = qBound(0, maxStops, (int)HeldKarp::maxStops);
+}
+
+// Builds the candidate lists of the given stops from the selected candidate graph (at most k per stop)
+void DeliveryPlanner::BuildCandidates(CandidateNeighbors &candidates, const QVector<int> &candidateStops, int k) const{
+    if(candidateGraph == delaunayCandidates)
+        candidates.BuildDelaunay(stops.x, stops.y, candidateStops, k, threadCount);
+    else
+        candidates.BuildNearest(stops.x, stops.y, candidateStops, k, threadCount);
+}
+
+// Selects the graph the candidate neighbors of all stages come from and the length of their lists
+void DeliveryPlanner::SetCandidates(CandidateGraph graph, int count){
+    candidateGraph = graph;
+    candidateCount = qMax(1, count);
+}
+
+// Distances between the stops of the run
+DistanceFunction DeliveryPlanner::Distance() const{
+    return DistanceFunction(stops.x, stops.y, &distanceMatrix);
+}
 
+// Sets up the fleet: count vehicles that carry at most capacity each (capacity <= 0: unlimited).
+// One vehicle without a capacity plans a single tour, otherwise every vehicle gets one route. If the
+// loads or windows need more routes than there are vehicles, all routes are still returned so every
+// stop is planned, and FleetFeasible() is false. Plans with requests are a single tour that ignores the
+// fleet, the capacity and all time windows; FleetIgnored() tells if this happened.
+void DeliveryPlanner::SetFleet(int count, double capacity){
+    vehicleCount = qMax(1, count);
+    vehicleCapacity = capacity;
+}
+
+// Sets the time window and the service time of the depot (kind depotStop, index 0: the vehicles have to
+// leave and return within it), of a delivery point or of a pickup point. Planning with windows always
+// uses the fleet routes, even for a single vehicle. Requests cannot have windows, and as long as there
+// are requests all windows are ignored (FleetIgnored() is true after the plan).
+void DeliveryPlanner::SetTimeWindow(StopKind kind, int index, double earliest, double latest, double serviceTime){
+    TimeWindow window(earliest, latest, serviceTime);
+    switch(kind){
+        case depotStop: depotWindow = window; break;
+        case deliveryStop: windowDelivery[index] = window; break;
+        case pickupStop: windowPickup[index] = window; break;
+        case requestPickupStop: case requestDeliveryStop: return; // requests are planned without windows
+    }
+    timeWindows = true;
+}
+
+// Sets the distance a vehicle drives per time unit
+void DeliveryPlanner::SetTravelSpeed(double speed){
+    travelSpeed = speed;
 }
 
 // Adds a delivery point
-void DeliveryPlanner::AddDeliveryPoint(double x, double y){
+void DeliveryPlanner::AddDeliveryPoint(double x, double y, double demand){
     xDelivery.append(x);
     yDelivery.append(y);
+    demandDelivery.append(demand);
+    windowDelivery.append(TimeWindow());
     deliveryCount++;
 }
 
+// Adds a delivery point to the finished plan without planning again: it is inserted where it adds the least
+// length, all other stops keep their order, and the length grows by that increase. The new stop goes to the
+// end of the stop store until the next plan, behind the pickup points and the requests, so until then
+// their stop indices do not follow deliveryCount (FirstRequestStop() must not be used). Without a plan the
+// point is only added. Plans with capacities or time windows are left as they are, as an insertion could
+// break them: the caller has to calculate the plan again (on its planning thread, it may take long).
+// Returns the length of the plan, -1 in that case.
+double DeliveryPlanner::InsertDeliveryPoint(double x, double y, double demand){
+    AddDeliveryPoint(x, y, demand);
+    if(plannedRoutes.isEmpty())
+        return 0;
+    if(vehicleCapacity > 0 || timeWindows)
+        return -1;
+
+    int stop = stops.Count();
+    stops.Append(x, y, deliveryStop, deliveryCount - 1, demand);
+    stopsAppended = true;
+    // The matrix does not hold the new stop, and the appended coordinates may have moved
+    distanceMatrix.Clear();
+    insertionDistance = Distance();
+    if(!insertionReady){
+        insertionSearch.Build(plannedRoutes);
+        insertionReady = true;
+    }
+
+    InsertionSearch::Insertion insertion = insertionSearch.Cheapest(stop);
+    // Index of the insertion in the joined plan: consecutive routes share the depot in between
+    int planned = insertion.position;
+    for(int r = 0; r < insertion.route; r++)
+        planned += plannedRoutes.at(r).count() - 1;
+    plannedRoutes[insertion.route].insert(insertion.position, stop);
+    insertionSearch.Insert(stop, insertion);
+    plannedLength += insertion.increase;
+
+    xRoutes[insertion.route].insert(insertion.position, x);
+    yRoutes[insertion.route].insert(insertion.position, y);
+    xPlanned.insert(planned, x);
+    yPlanned.insert(planned, y);
+    PublishPlan();
+    return plannedLength;
+}
+
+// Adds a request: the goods are picked up at (xPickup, yPickup) and delivered to (xDelivery, yDelivery).
+// Requests are planned on a single tour; the fleet settings and the time windows do not apply to the plan then.
+void DeliveryPlanner::AddRequest(double xPickup, double yPickup, double xDelivery, double yDelivery){
+    xRequestPickup.append(xPickup); yRequestPickup.append(yPickup);
+    xRequestDelivery.append(xDelivery); yRequestDelivery.append(yDelivery);
+    requestCount++;
+}
+
 // Adds a pickup point
 void DeliveryPlanner::AddPickupPoint(double x, double y){
     xPickup.append(x);
     yPickup.append(y);
+    windowPickup.append(TimeWindow());
     pickupCount++;
 }
 
@@ -90,41 +1016,76 @@ void DeliveryPlanner::Reset(){
     xDelivery.clear(); yDelivery.clear();
     xPickup.clear(); yPickup.clear();
     xPlanned.clear(); yPlanned.clear();
+    xRoutes.clear(); yRoutes.clear();
+    plans.Take(); // a plan of the old points that has not been shown yet
+    demandDelivery.clear();
+    xRequestPickup.clear(); yRequestPickup.clear();
+    xRequestDelivery.clear(); yRequestDelivery.clear();
+    windowDelivery.clear(); windowPickup.clear();
+    depotWindow = TimeWindow();
+    timeWindows = false;
 
-    deliveryCount = 0; pickupCount = 0;
+    deliveryCount = 0; pickupCount = 0; requestCount = 0;
 
-    for (auto const& i : eventList) {
-        delete i;
-    }
-    eventList.clear();
-    deliveryEventList.clear();
+    stops.Clear();
+    plannedRoutes.clear();
+    plannedLength = 0;
+    insertionReady = false;
+    constructions.clear();
+    // The indexes, the matrix, the candidate lists and the work arrays of the stages keep their memory,
+    // so planning many instances in a row (BatchPlanner) does not allocate them again
+    spatialIndex.Clear();
+    bruteForceIndex.Clear();
+    distanceMatrix.Reset();
 
 }
 
-// Fills the eventList with the delivery points, pickup points and the depot point
-void DeliveryPlanner::FillEventList(){
-    eventList.push_back(new Event(xDepot.at(0), yDepot.at(0), 0));
+// Fills the stop store with the depot point, the delivery points, the pickup points and the requests (in this order)
+void DeliveryPlanner::FillStopStore(){
+    stops.Clear();
+    stopsAppended = false;
+    stops.Reserve(1 + xDelivery.count() + xPickup.count() + 2 * requestCount);
+
+    stops.Append(xDepot.at(0), yDepot.at(0), depotStop, 0, 0, depotWindow);
 
     int deliveryCount = xDelivery.count();
     for(int i = 0; i < deliveryCount; i++){
-        eventList.push_back(new Event(xDelivery.at(i), yDelivery.at(i), i + 1));
+        stops.Append(xDelivery.at(i), yDelivery.at(i), deliveryStop, i, demandDelivery.at(i), windowDelivery.at(i));
     }
 
     int pickupCount = xPickup.count();
     for(int i = 0; i < pickupCount; i++){
-        eventList.push_back(new Event(xPickup.at(i), yPickup.at(i), i + deliveryCount + 1));
+        stops.Append(xPickup.at(i), yPickup.at(i), pickupStop, i, 0, windowPickup.at(i));
+    }
+
+    // Requests follow as pairs: pickup at FirstRequestStop() + 2 i, delivery right behind it
+    for(int i = 0; i < requestCount; i++){
+        int pickup = stops.Count();
+        stops.Append(xRequestPickup.at(i), yRequestPickup.at(i), requestPickupStop, i, 0, TimeWindow(), pickup + 1);
+        stops.Append(xRequestDelivery.at(i), yRequestDelivery.at(i), requestDeliveryStop, i, 0, TimeWindow(), pickup);
     }
 }
 
-// Prepare planned route vectors for plotting
+// Prepare planned route vectors for plotting: one pair per vehicle route and all routes joined at the depot
 void DeliveryPlanner::FillPlannedRoute(){
-    for (auto const& i : deliveryEventList) {
-        xPlanned.push_back(i->GetX());
-        yPlanned.push_back(i->GetY());
+    xRoutes.resize(plannedRoutes.count()); yRoutes.resize(plannedRoutes.count());
+    for(int r = 0; r < plannedRoutes.count(); r++){
+        const QVector<int> &route = plannedRoutes.at(r);
+        xRoutes[r].resize(route.count()); yRoutes[r].resize(route.count());
+        for(int i = 0; i < route.count(); i++){
+            xRoutes[r][i] = stops.x.at(route.at(i));
+            yRoutes[r][i] = stops.y.at(route.at(i));
+            // Consecutive routes share the depot in between
+            if(i > 0 || r == 0){
+                xPlanned.append(xRoutes.at(r).at(i));
+                yPlanned.append(yRoutes.at(r).at(i));
+            }
+        }
     }
 }
 
 // Executed on finish
 DeliveryPlanner::~DeliveryPlanner(){
     Reset();
+    delete scheduler;
 }
@@ -2,7 +2,62 @@
 #define DELIVERYPLANNER_H
 
 #include <QVector>
-#include "event.h"
+#include <atomic>
+#include <functional>
+#include "stopstore.h"
+#include "spatialindex.h"
+#include "bruteforceindex.h"
+#include "distancematrix.h"
+#include "distancefunction.h"
+#include "candidateneighbors.h"
+#include "improvementbudget.h"
+#include "improvementscratch.h"
+#include "timewindows.h"
+#include "insertionsearch.h"
+#include "routestream.h"
+#include "taskscheduler.h"
+#include "plansnapshot.h"
+#include "splitrandom.h"
+
+// Improvement stage that runs on the constructed route
+enum ImprovementStage{
+    noImprovement,
+    twoOptImprovement,
+    orOptImprovement,
+    twoOptOrOptImprovement, // 2-opt followed by Or-opt
+    linKernighanImprovement // 2-opt and Or-opt, then chained Lin-Kernighan until the budget is used up
+};
+
+// Construction of the single vehicle tour
+enum ConstructionMethod{
+    nearestNeighborConstruction,
+    spaceFillingCurveConstruction, // order along a Hilbert curve: O(n log n) and parallel, for very large instances
+    greedyEdgeConstruction // shortest candidate edges first, then the paths are joined
+};
+
+// Graph the candidate neighbors of the stages are taken from
+enum CandidateGraph{
+    nearestCandidates, // k nearest neighbors
+    delaunayCandidates // Delaunay neighbors, filled up with their neighbors
+};
+
+// Length and runtime of a construction on the current points
+struct ConstructionReport
+{
+    ConstructionMethod method;
+    double length; // length of the constructed tour (without the pickup point and without improvement)
+    qint64 milliseconds; // runtime of the construction
+};
+
+// Result of the last decomposed plan
+struct DecompositionReport
+{
+    int clusters; // number of clusters that were planned on their own (0: the last plan was not decomposed)
+    double clusterLength; // total length of the closed cluster tours
+    double linkLength; // total length of the edges that link the clusters (and the depot) before the seams are repaired
+    double length; // length of the stitched tour (without the pickup point)
+    DecompositionReport(): clusters(0), clusterLength(0), linkLength(0), length(0) {}
+};
 
 class DeliveryPlanner
 {
@@ -11,19 +66,121 @@ public:
     ~DeliveryPlanner();
     QVector<double> xDelivery, yDelivery; // hold the current delivery points of the planner
     QVector<double> xPickup, yPickup; // hold the current pickup points of the planner
+    QVector<double> xRequestPickup, yRequestPickup; // hold the pickup points of the current requests
+    QVector<double> xRequestDelivery, yRequestDelivery; // hold the delivery points of the current requests
     QVector<double> xDepot, yDepot; // holds the coordinate of the depot
-    QVector<double> xPlanned, yPlanned; // holds the calculated planned delivery route
-    void AddDeliveryPoint(double x, double y); // adds another delivery point
+    QVector<double> xPlanned, yPlanned; // holds the calculated planned delivery route (all vehicle routes joined at the depot), only for the calculating thread
+    QVector<QVector<double>> xRoutes, yRoutes; // hold the planned route of every vehicle (depot at both ends)
+    void AddDeliveryPoint(double x, double y, double demand = 1); // adds another delivery point with the load it needs
+    double InsertDeliveryPoint(double x, double y, double demand = 1); // adds a delivery point to the finished plan, returns the new length (-1: plan again)
     void AddPickupPoint(double x, double y); // adds another pickup point
+    void AddRequest(double xPickup, double yPickup, double xDelivery, double yDelivery); // adds a pickup that has to be delivered to a point
     void Reset(); // resets the planner to the initial state
-    double CalculateDeliveryPlan(); // calculates the delivery plan (nearest neighbor algorithm)
+    void SetImprovement(ImprovementStage stage, ImprovementBudget budget = ImprovementBudget()); // selects the improvement stage
+    void SetConstruction(ConstructionMethod method); // selects the construction of the single vehicle tour
+    void SetCandidates(CandidateGraph graph, int count = 8); // selects the candidate neighbors of the stages and their number per stop
+    void SetThreadCount(int count); // sets the number of threads of the parallel stages (0: one per core)
+    void SetFleet(int count, double capacity); // sets the number of vehicles and their capacity (<= 0: unlimited)
+    bool FleetFeasible() const { return fleetFeasible; } // false if the last plan needs more routes than there are vehicles
+    bool FleetIgnored() const { return fleetIgnored; } // true if the last plan had requests and ignored the fleet and the time windows
+    void SetTimeWindow(StopKind kind, int index, double earliest, double latest, double serviceTime = 0); // sets the time window of a stop
+    void SetTravelSpeed(double speed); // sets the distance a vehicle drives per time unit
+    void SetMultiStart(int count); // sets the number of parallel constructions (1: depot start only, 0: defaultStarts)
+    void SetSeed(quint64 seed); // sets the seed of all random choices of the stages
+    void SetDistanceMatrix(int maxStops, qint64 memoryCap); // precomputes the distances of instances up to maxStops stops (0: never)
+    void SetDecomposition(int minStops, int clusterCount = 0); // plans tours with at least minStops stops in clusters (0: never)
+    static const int defaultStarts = 8; // number of multi-start constructions if none is set
+    static const int clusterStops = 5000; // stops per cluster of a decomposition if no cluster count is set
+    DecompositionReport LastDecomposition() const { return decomposition; } // clusters and link length of the last plan
+    void SetExactSolver(int maxStops); // solves tours with up to maxStops stops exactly (0: never)
+    qint64 DistanceMatrixMemory() const; // bytes the distance matrix of the current points takes (0: distances are computed on the fly)
+    double CalculateDeliveryPlan(); // calculates the delivery plan (construction + improvement stage)
+    void SetProgress(std::function<void(int placedStops, double length)> callback); // called by the calculating thread while a plan is calculated
+    void SetRouteStream(std::function<void(const QVector<double> &x, const QVector<double> &y, double length)> receiver,
+                        qint64 interval = 100); // receives the improving tour at most once per interval while a plan is calculated
+    QSharedPointer<const PlanSnapshot> TakePlan() { return plans.Take(); } // latest published plan not taken yet (null: none), from any thread
+    void Cancel(); // ends the running calculation early, may be called from any thread
+    void ClearCancel(); // lets the next calculation run to its end again (call before it is queued)
+    bool Cancelled() const { return cancelled.load(); } // true if the calculations are cancelled since the last ClearCancel()
+    QVector<ConstructionReport> CompareConstructions(); // runs every construction on the current points
+    QVector<ConstructionReport> LastConstructions() const { return constructions; } // reports of the last comparison
+    double CalculateLowerBound(ImprovementBudget budget = ImprovementBudget(200)); // lower bound of the plan length for the points of the last plan
 private:
-    QVector<Event*> eventList; // holds the remaining event points that are not part of the route yet
-    QVector<Event*> deliveryEventList; // holds the events that are part of the planned route
+    StopStore stops; // holds all stop points of the run: depot (index 0), delivery points, pickup points
+    SpatialIndex spatialIndex; // holds the remaining stop points that are not part of the route yet
+    BruteForceIndex bruteForceIndex; // replaces the spatial index for small instances
+    DistanceMatrix distanceMatrix; // precomputed distances of the run (empty: computed on the fly)
+    QVector<double> demandDelivery; // load every delivery point needs
+    QVector<TimeWindow> windowDelivery, windowPickup; // time windows of the delivery and pickup points
+    TimeWindow depotWindow; // time in which the vehicles leave and return to the depot
+    QVector<QVector<int>> plannedRoutes; // holds the stop indices of the planned route of every vehicle (depot at both ends)
+    double plannedLength; // total length of the planned routes
+    DistanceFunction insertionDistance; // distances of the inserted delivery points (renewed with every point)
+    InsertionSearch insertionSearch; // cheapest insertion into the planned routes (built by the first inserted point)
+    bool insertionReady; // true if the insertion search is built on the planned routes
+    CandidateNeighbors tourCandidates; // candidate lists of the single tour (kept, so the next plan reuses their memory)
+    CandidateNeighbors fleetCandidates, routeCandidates; // candidate lists across the vehicle routes and within every route (kept as well)
+    mutable QVector<ImprovementScratch> improvementScratch; // work arrays of the improvement stages, one per worker (kept between plans)
+    bool stopsAppended; // true if inserted points were appended to the stop store since FillStopStore()
+    QVector<ConstructionReport> constructions; // reports of the last comparison of the constructions
     uint deliveryCount; // number of delivery points
     uint pickupCount; // number of pickup points
-    void FillEventList(); // prepares the eventList for the algorithm
+    int requestCount; // number of requests
+    int candidateCount; // number of candidate neighbors per stop for the improvement
+    CandidateGraph candidateGraph; // graph the candidate neighbors are taken from
+    int bruteForceLimit; // largest number of stops that is constructed with the brute force index
+    int matrixLimit; // largest number of stops whose distances are precomputed (0: never)
+    qint64 matrixMemoryCap; // largest distance matrix in bytes
+    int decompositionLimit; // smallest number of tour stops that is planned in clusters (0: never)
+    int decompositionClusters; // number of clusters (0: one per clusterStops stops)
+    DecompositionReport decomposition; // clusters and link length of the last plan
+    int exactLimit; // largest number of tour stops (without the depot) that is solved exactly (0: never)
+    int vehicleCount; // number of vehicles
+    double vehicleCapacity; // load limit of every vehicle (<= 0: unlimited)
+    bool fleetFeasible; // false if the last plan has more routes than vehicles
+    bool fleetIgnored; // true if the last plan had requests and ignored the fleet settings and the time windows
+    double travelSpeed; // distance per time unit
+    bool timeWindows; // true if any time window has been set
+    ConstructionMethod constructionMethod; // selected construction of the single vehicle tour
+    ImprovementStage improvementStage; // selected improvement stage
+    ImprovementBudget improvementBudget; // iteration and time budget of the improvement stage
+    int threadCount; // number of threads of the parallel stages (0: one per core)
+    TaskScheduler *scheduler; // pool the parallel stages run on (created by the first calculation, nullptr: none yet)
+    int startCount; // number of nearest neighbor constructions of the multi-start mode (0: defaultStarts)
+    quint64 seed; // seed of the random choices of the stages
+    std::atomic<bool> cancelled; // set by Cancel(), ends the improvement stages and the lower bound
+    std::function<void(int placedStops, double length)> progress; // receives the progress of the calculation (empty: none)
+    std::function<void(const QVector<double> &x, const QVector<double> &y, double length)> tourReceiver; // receives the improving tour (empty: none)
+    qint64 streamInterval; // minimum time between two tours for the receiver in milliseconds
+    mutable PlanMailbox plans; // latest plan or streamed tour for other threads
+    void FillStopStore(); // prepares the stop store for the algorithm
+    TaskScheduler *Scheduler(); // the planner's pool, nullptr if the calling thread runs in a pool already
+    SplitRandom Random(int stage) const { return SplitRandom(seed).Split(stage); } // random numbers of a stage (see RandomStage)
+    int FirstRequestStop() const { Q_ASSERT(!stopsAppended); return 1 + deliveryCount + pickupCount; } // stop index of the pickup of the first request (not after inserted points)
+    DistanceFunction Distance() const; // distances between the stops of the run (from the matrix if there is one)
+    void BuildCandidates(CandidateNeighbors &candidates, const QVector<int> &candidateStops, int k) const; // candidate lists from the selected graph
     void FillPlannedRoute(); // Gets filled with the planned route after the algorithm finishes
+    void PublishPlan(); // publishes the planned route for other threads
+    void ReportProgress(int placedStops, double length) const; // passes the progress to the callback
+    void PublishTour(const QVector<int> &tour, double length) const; // publishes the coordinates of a tour and passes them to the receiver
+    template<class Index> double ConstructRoute(Index &index, QVector<int> &route) const; // single or multi-start construction, returns the length
+    template<class Index> double ConstructNearestNeighborRoute(Index &index, int firstStop, QVector<int> &route,
+                                                               bool report = false) const; // nearest neighbor construction, returns the length
+    template<class Index> double ConstructMultiStartRoute(const Index &prototype, int starts, QVector<int> &route) const; // parallel multi-start construction, returns the length
+    void ConstructTour(ConstructionMethod method, QVector<int> &route); // constructs the single vehicle tour, the route starts at the depot
+    void ConstructCurveRoute(QVector<int> &route) const; // space-filling-curve construction, the route starts at the depot
+    void ConstructGreedyRoute(QVector<int> &route) const; // greedy edge construction, the route starts at the depot
+    void KeepPrecedence(QVector<int> &route) const; // moves deliveries of requests behind their pickups
+    double CalculateTourPlan(); // single vehicle: one tour through all stops, returns its length
+    double CalculateExactTourPlan(); // single vehicle, few stops: shortest tour by Held-Karp, returns its length
+    double CalculateDecomposedTourPlan(); // single vehicle, many stops: clusters planned in parallel and stitched, returns the length
+    double CalculateFleetPlan(); // several vehicles or a capacity: one route per vehicle, returns the total length
+    double InsertPickup(QVector<QVector<int>> &routes, TimeWindowSchedule *schedule); // inserts the cheapest pickup point into the routes, returns the added length
+    double ImproveRoutes(QVector<QVector<int>> &routes, TimeWindowSchedule &schedule); // improves the vehicle routes, returns the total length
+    double ImproveRoute(const DistanceFunction &distance, QVector<int> &route, const CandidateNeighbors &candidates,
+                        const ImprovementBudget &budget, const SplitRandom &random, ImprovementScratch *scratch,
+                        RouteStream *stream = nullptr) const; // runs the improvement stage on the route, returns the new length
+    ImprovementScratch *Scratch(int workers) const; // work arrays of the improvement stages for workers 0 .. workers - 1
 };
 
 #endif // DELIVERYPLANNER_H
@@ -9,12 +9,15 @@ DeliveryViewer::DeliveryViewer(QWidget *parent)
     , deliveryPlanner(new DeliveryPlanner())
     , currentStep(StepSelection::deliverySelection)
     , plottedDeliveryPlans(0)
+    , planningWorker(new PlanningWorker(deliveryPlanner))
+    , planning(false)
+    , planStreamed(false)
+    , latestPlan(nullptr)
+    , shownBound(0)
 {
     // Setup the gui and the plot
     ui->setupUi(this);
 
-    srand(QDateTime::currentDateTime().toTime_t());
-
     ui->deliveryPlot->setInteractions(QCP::iRangeDrag | QCP::iRangeZoom | QCP::iSelectAxes |
                                     QCP::iSelectLegend | QCP::iSelectPlottables);
     ui->deliveryPlot->xAxis->setRange(-8, 8);
@@ -55,6 +58,15 @@ DeliveryViewer::DeliveryViewer(QWidget *parent)
     // Connect the signals so that the user can step back and continue
     QObject::connect(ui->btnBack, SIGNAL(pressed()), this, SLOT(StepBack()));
     QObject::connect(ui->btnContinue, SIGNAL(pressed()), this, SLOT(StepContinue()));
+    QObject::connect(ui->btnCancel, SIGNAL(pressed()), this, SLOT(CancelPlanning()));
+
+    // Plans are calculated on their own thread; its signals arrive queued on the GUI thread
+    planningWorker->moveToThread(&planningThread);
+    QObject::connect(planningWorker, SIGNAL(Progress(int,double)), this, SLOT(ShowProgress(int,double)));
+    QObject::connect(planningWorker, SIGNAL(Planned(double)), this, SLOT(ShowPlan(double)));
+    QObject::connect(planningWorker, SIGNAL(Finished(double,double)), this, SLOT(PlanFinished(double,double)));
+    QObject::connect(planningWorker, SIGNAL(TourImproved()), this, SLOT(ShowImprovedTour()));
+    planningThread.start();
 }
 
 void DeliveryViewer::AddStandardGraphs(){
@@ -80,16 +92,21 @@ void DeliveryViewer::AddStandardGraphs(){
 
 DeliveryViewer::~DeliveryViewer()
 {
+    // A running calculation has to end before the planner goes away
+    deliveryPlanner->Cancel();
+    planningThread.quit();
+    planningThread.wait();
+    delete planningWorker;
+
     delete ui;
     delete deliveryPlanner;
-
-    for (auto const& i : lines) {
-        delete i;
-    }
 }
 
 // Gets triggered when user double clicks the plot
 void DeliveryViewer::AddPoint(QMouseEvent *event){
+    // The planner belongs to the planning thread while it calculates
+    if(planning)
+        return;
     // Get coordinates of input
     double x; double y;
     if(event->button() == Qt::LeftButton)
@@ -110,6 +127,20 @@ void DeliveryViewer::AddPoint(QMouseEvent *event){
                                 ui->deliveryPlot->graph(1)->setData(deliveryPlanner->xPickup, deliveryPlanner->yPickup);
                                 break;
         }
+        // A point added to a finished plan is inserted into its route; constrained plans are calculated
+        // again on the planning thread
+        // The bound of the plan still holds: inserting points only makes it longer
+        case deliveryPlan:{     double length = deliveryPlanner->InsertDeliveryPoint(x, y);
+                                ui->deliveryPlot->graph(0)->setData(deliveryPlanner->xDelivery, deliveryPlanner->yDelivery);
+                                if(length < 0){
+                                    StartPlanning(true);
+                                    ui->deliveryPlot->replot();
+                                }else if(latestPlan && TakePlan())
+                                    UpdateDeliveryPlot(shownPlan->x, shownPlan->y, shownPlan->length, shownBound);
+                                else
+                                    ui->deliveryPlot->replot();
+                                break;
+        }
     }
 }
 
@@ -148,13 +179,9 @@ void DeliveryViewer::StepContinue(){
         case deliveryPlan: {currentStep = deliveryPlan;
                            break;
         }
-        // Perform the calculation of the delivery route (nearest neighbor algorithm)
-        case pickupSelection: {currentStep = (StepSelection)(((int)currentStep) + 1);
-                              // Perform algorithm to find the delivery plan
-                              double length = deliveryPlanner->CalculateDeliveryPlan(); // length of the route
-                              // Plot the new route
-                              NewDeliveryPlot(deliveryPlanner->xPlanned, deliveryPlanner->yPlanned, length);
-                              break;
+        // Start the calculation of the delivery route on the planning thread, PlanFinished() plots it
+        case pickupSelection: {StartPlanning(false);
+                              return;
         }
         // Next step
         case deliverySelection: {currentStep = (StepSelection)(((int)currentStep) + 1);
@@ -165,39 +192,151 @@ void DeliveryViewer::StepContinue(){
     UpdateStepLabel();
 }
 
-// Plots a ne delivery route (Length: length)
-void  DeliveryViewer::NewDeliveryPlot(QVector<double> xPlanned, QVector<double> yPlanned, double length){
+// Starts the calculation of the delivery plan on the planning thread, PlanFinished() plots it. A plan that
+// is calculated again replaces the route of the latest plan instead of getting a new one.
+void DeliveryViewer::StartPlanning(bool replan){
+    planning = true;
+    planStreamed = replan && latestPlan != nullptr;
+    ui->btnBack->setEnabled(false);
+    ui->btnContinue->setEnabled(false);
+    ui->btnCancel->setEnabled(true);
+    ui->lblStep->setText("Planning...");
+    // A cancel between now and the start of the calculation still ends it
+    deliveryPlanner->ClearCancel();
+    QMetaObject::invokeMethod(planningWorker, "Plan", Qt::QueuedConnection);
+}
+
+// User presses the "Cancel" button: the planner stops improving and the route reached so far is plotted
+void DeliveryViewer::CancelPlanning(){
+    if(planning)
+        deliveryPlanner->Cancel();
+}
+
+// Shows the stops that are on the route so far and their length while a plan is calculated
+void DeliveryViewer::ShowProgress(int placedStops, double length){
+    if(planning)
+        ui->lblStep->setText(QString(QLatin1String("Planning... %1 stops placed; Length: %2"))
+                             .arg(placedStops)
+                             .arg(length));
+}
+
+// The plan is calculated: it is plotted right away, while the planning thread still compares the
+// constructions and calculates the lower bound. The planner stays busy until PlanFinished().
+void DeliveryViewer::ShowPlan(double length){
+    if(!planning)
+        return;
+    // The plan may have been taken by ShowImprovedTour() already
+    TakePlan();
+    if(planStreamed)
+        UpdateDeliveryPlot(shownPlan->x, shownPlan->y, length, 0);
+    else
+        NewDeliveryPlot(shownPlan->x, shownPlan->y, length, 0);
+    planStreamed = true;
+    ui->lblStep->setText(QString(QLatin1String("Comparing the constructions... Length: %1")).arg(length));
+}
+
+// The planning thread is done: the planner is ours again and the plot of the plan gets its lower bound
+// (Length: length, bound 0 if the calculation was cancelled)
+void DeliveryViewer::PlanFinished(double length, double bound){
+    planning = false;
+    ui->btnBack->setEnabled(true);
+    ui->btnContinue->setEnabled(true);
+    ui->btnCancel->setEnabled(false);
+    currentStep = deliveryPlan;
+    shownBound = bound;
+    // The finished plan may have been taken by ShowImprovedTour() or ShowPlan() already
+    TakePlan();
+    // The plotted plan gets the bound
+    if(planStreamed)
+        UpdateDeliveryPlot(shownPlan->x, shownPlan->y, length, bound);
+    else
+        NewDeliveryPlot(shownPlan->x, shownPlan->y, length, bound);
+    planStreamed = false;
+    UpdateStepLabel();
+    ShowConstructions();
+}
+
+// Adds the length and the runtime of every construction on the points of the plan to the step label.
+// A cancelled plan has no comparison.
+void DeliveryViewer::ShowConstructions(){
+    if(deliveryPlanner->Cancelled())
+        return;
+    QString text;
+    for(const ConstructionReport &report : deliveryPlanner->LastConstructions()){
+        QString name;
+        switch(report.method){
+            case nearestNeighborConstruction: name = "Nearest neighbor"; break;
+            case spaceFillingCurveConstruction: name = "Hilbert curve"; break;
+            case greedyEdgeConstruction: name = "Greedy edge"; break;
+        }
+        text += QString(QLatin1String("%1%2: %3 (%4 ms)"))
+                .arg(text.isEmpty() ? QString("Constructions: ") : QString("; "))
+                .arg(name)
+                .arg(report.length)
+                .arg(report.milliseconds);
+    }
+    if(!text.isEmpty())
+        ui->lblStep->setText(ui->lblStep->text() + "\n" + text);
+}
+
+// Shows the tour that is being improved: the first one gets a new plan, later ones replace its route.
+// Signals that arrive after a newer tour has been shown find no snapshot and are skipped.
+void DeliveryViewer::ShowImprovedTour(){
+    if(!planning || !TakePlan())
+        return;
+    if(planStreamed){
+        UpdateDeliveryPlot(shownPlan->x, shownPlan->y, shownPlan->length, 0);
+    }else{
+        NewDeliveryPlot(shownPlan->x, shownPlan->y, shownPlan->length, 0);
+        planStreamed = true;
+    }
+}
+
+// Takes the latest plan the planner has published. This does not wait for the planning thread and does
+// not copy the route: the snapshot is shared with the planner until it publishes the next one.
+bool DeliveryViewer::TakePlan(){
+    QSharedPointer<const PlanSnapshot> snapshot = deliveryPlanner->TakePlan();
+    if(!snapshot)
+        return false;
+    shownPlan = snapshot;
+    return true;
+}
+
+// Plots a new delivery route (Length: length, gap to the lower bound) as a curve through its points in
+// the order they are visited
+void  DeliveryViewer::NewDeliveryPlot(const QVector<double> &xPlanned, const QVector<double> &yPlanned, double length, double bound){
     plottedDeliveryPlans++;
-    int currentPlot = 2 + plottedDeliveryPlans;
     // Setup the plot
-    ui->deliveryPlot->addGraph();
+    latestPlan = new QCPCurve(ui->deliveryPlot->xAxis, ui->deliveryPlot->yAxis);
     // Colour selection
     if(plottedDeliveryPlans <= 9)
-        ui->deliveryPlot->graph(currentPlot)->setPen(QPen((Qt::GlobalColor)(9 + plottedDeliveryPlans)));
+        latestPlan->setPen(QPen((Qt::GlobalColor)(9 + plottedDeliveryPlans)));
     else
-        ui->deliveryPlot->graph(currentPlot)->setPen(QPen(Qt::black));
+        latestPlan->setPen(QPen(Qt::black));
     // Style of line
-    ui->deliveryPlot->graph(currentPlot)->setLineStyle(QCPGraph::lsNone);
-    ui->deliveryPlot->graph(currentPlot)->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssCross, 12));
+    latestPlan->setLineStyle(QCPCurve::lsLine);
+    latestPlan->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssCross, 12));
 
+    UpdateDeliveryPlot(xPlanned, yPlanned, length, bound);
+}
+
+// Replots the latest delivery plan with a new route (Length: length, gap to the lower bound if there is
+// one), e.g. an improved route while it is calculated or the route with inserted points. Only its curve
+// gets new data.
+void DeliveryViewer::UpdateDeliveryPlot(const QVector<double> &xPlanned, const QVector<double> &yPlanned, double length, double bound){
     // Legend text
     QString legendText = QString(QLatin1String("Plan %1; Length: %2"))
                         .arg(plottedDeliveryPlans)
                         .arg(length);
-    ui->deliveryPlot->graph(currentPlot)->setName(legendText);
-
-    ui->deliveryPlot->graph(currentPlot)->setData(xPlanned, yPlanned, true);
-
-    // Connect all points by lines
-    for(int i = 0; i < xPlanned.count() - 1; i++){
-        QCPItemLine *line = new QCPItemLine(ui->deliveryPlot);
-        lines.push_back(line);
-        line->start->setCoords(xPlanned.at(i), yPlanned.at(i));
-        line->end->setCoords(xPlanned.at(i+1), yPlanned.at(i+1));
-        ui->deliveryPlot->replot();
-    }
-
-
+    // The gap says how much shorter the plan could be at most
+    if(bound > 0)
+        legendText += QString(QLatin1String("; Bound: %1; Gap: %2%"))
+                        .arg(bound)
+                        .arg(100 * (length - bound) / bound, 0, 'f', 1);
+    latestPlan->setName(legendText);
+
+    latestPlan->setData(xPlanned, yPlanned);
+    ui->deliveryPlot->replot();
 }
 
 // Updates the step label depending on the current step
@@ -207,7 +346,8 @@ void DeliveryViewer::UpdateStepLabel(){
                                                 "delivery points. Press \"Continue\" afterwards. You can start a new delivery plan by clicking \"Back\"."); break;
         case pickupSelection: ui->lblStep->setText("Step 2: Double click to select your "
                                                 "pickup points. Press \"Continue\" afterwards to get the route."); break;
-        case deliveryPlan: ui->lblStep->setText("Step 3: Delivery Plan computed! You can start a new delivery plan by returning to Step 1."); break;
+        case deliveryPlan: ui->lblStep->setText("Step 3: Delivery Plan computed! Double click to add more delivery points to it. "
+                                                "You can start a new delivery plan by returning to Step 1."); break;
     }
 }
 
@@ -241,15 +381,15 @@ void DeliveryViewer::selectionChanged()
     ui->deliveryPlot->yAxis->setSelectedParts(QCPAxis::spAxis|QCPAxis::spTickLabels);
   }
 
-  // synchronize selection of graphs with selection of corresponding legend items:
-  for (int i=0; i<ui->deliveryPlot->graphCount(); ++i)
+  // synchronize selection of graphs and plan curves with selection of corresponding legend items:
+  for (int i=0; i<ui->deliveryPlot->plottableCount(); ++i)
   {
-    QCPGraph *graph = ui->deliveryPlot->graph(i);
-    QCPPlottableLegendItem *item = ui->deliveryPlot->legend->itemWithPlottable(graph);
-    if (item->selected() || graph->selected())
+    QCPAbstractPlottable *plottable = ui->deliveryPlot->plottable(i);
+    QCPPlottableLegendItem *item = ui->deliveryPlot->legend->itemWithPlottable(plottable);
+    if (item->selected() || plottable->selected())
     {
       item->setSelected(true);
-      graph->setSelection(QCPDataSelection(graph->data()->dataRange()));
+      plottable->setSelection(QCPDataSelection(QCPDataRange(0, plottable->interface1D()->dataCount())));
     }
   }
 }
@@ -282,12 +422,12 @@ void DeliveryViewer::mouseWheel()
 
 void DeliveryViewer::removeAllGraphs()
 {
-  ui->deliveryPlot->clearGraphs();
-
-  for (auto const& i : lines) {
-      delete i;
-  }
-  lines.clear();
+  if (planning)
+    return;
+  ui->deliveryPlot->clearPlottables();
+  latestPlan = nullptr;
+  shownBound = 0;
+  shownPlan.clear();
   AddStandardGraphs();
   plottedDeliveryPlans = 0;
   ui->deliveryPlot->replot();
@@ -4,6 +4,7 @@
 #include <QMainWindow>
 #include "qcustomplot.h"
 #include "deliveryplanner.h"
+#include "planningworker.h"
 
 enum StepSelection{
     deliverySelection,
@@ -28,14 +29,29 @@ private:
     DeliveryPlanner *deliveryPlanner; // Is respnsible for calculating the planned route
     StepSelection currentStep; // Current step
     uint plottedDeliveryPlans; // number of plotted plans
-    QVector<QCPItemLine*> lines; // lines of the delivery plans
+    QThread planningThread; // thread the plans are calculated on
+    PlanningWorker *planningWorker; // calculates the plans on the planning thread
+    bool planning; // true while a plan is calculated (the planner must not be touched)
+    bool planStreamed; // true if the running calculation has plotted its tour already
+    QCPCurve *latestPlan; // curve of the latest delivery plan (nullptr: none)
+    QSharedPointer<const PlanSnapshot> shownPlan; // route the latest plan shows (taken from the planner)
+    double shownBound; // lower bound of the latest plan (0: none)
+    void StartPlanning(bool replan); // calculates the plan on the planning thread (replan: replaces the latest plan)
+    bool TakePlan(); // takes the planner's latest snapshot as the shown plan, false if there is no new one
     void UpdateStepLabel(); // Updates the instruction label for the user
-    void NewDeliveryPlot(QVector<double> xPlanned, QVector<double> yPlanned, double length); // Plots a new delivery plan
+    void ShowConstructions(); // Adds the comparison of the constructions to the step label
+    void NewDeliveryPlot(const QVector<double> &xPlanned, const QVector<double> &yPlanned, double length, double bound); // Plots a new delivery plan
+    void UpdateDeliveryPlot(const QVector<double> &xPlanned, const QVector<double> &yPlanned, double length, double bound); // Replots the route of the latest plan
     void AddStandardGraphs(); // Plots the labels for the delivery, pickup and depot point
 private slots:
     void AddPoint(QMouseEvent *event); // User double clicks a point as a delivery/pickup point
     void StepBack(); // User steps one step back
     void StepContinue(); // User continues
+    void CancelPlanning(); // User cancels the running calculation
+    void ShowProgress(int placedStops, double length); // Shows the progress of the running calculation
+    void ShowPlan(double length); // Plots the calculated plan while the comparison and the bound run
+    void PlanFinished(double length, double bound); // Adds the bound and the comparison to the plotted plan
+    void ShowImprovedTour(); // Plots the tour while it is improved
     void selectionChanged();
     void mousePress();
     void mouseWheel();
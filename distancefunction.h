@@ -0,0 +1,37 @@
+#ifndef DISTANCEFUNCTION_H
+#define DISTANCEFUNCTION_H
+
+#include <QVector>
+#include <math.h>
+#include "distancematrix.h"
+
+// Euclidean distance between two stops given by their index into the planner's coordinate vectors.
+// All planner stages read their distances through this class. With a matrix the distances are looked
+// up instead of computed on the fly.
+class DistanceFunction
+{
+public:
+    DistanceFunction(const QVector<double> &x, const QVector<double> &y, const DistanceMatrix *matrix = nullptr):
+        x(x.constData()), y(y.constData()), count(x.count()),
+        matrix(matrix && !matrix->IsEmpty() ? matrix : nullptr) {}
+    double operator()(int a, int b) const { // distance between stop a and stop b
+        if(matrix)
+            return matrix->At(a, b);
+        return sqrt((x[a]-x[b])*(x[a]-x[b]) + (y[a]-y[b])*(y[a]-y[b]));
+    }
+    double RouteLength(const QVector<int> &route) const { // length of the closed route
+        double length = 0;
+        for(int i = 0; i < route.count(); i++)
+            length += (*this)(route.at(i), route.at((i + 1) % route.count()));
+        return length;
+    }
+    double X(int a) const { return x[a]; } // x coordinate of stop a
+    double Y(int a) const { return y[a]; } // y coordinate of stop a
+    int Count() const { return count; } // number of stops
+private:
+    const double *x; const double *y;
+    int count;
+    const DistanceMatrix *matrix; // precomputed distances (nullptr: computed on the fly)
+};
+
+#endif // DISTANCEFUNCTION_H
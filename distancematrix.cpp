@@ -0,0 +1,70 @@
+#include "distancematrix.h"
+#include "parallelfor.h"
+
+#include <math.h>
+
+const int DistanceMatrix::tileShift;
+const int DistanceMatrix::tileSize;
+const int DistanceMatrix::tileMask;
+const qint64 DistanceMatrix::maxMemory;
+
+DistanceMatrix::DistanceMatrix():
+    count(0)
+{
+
+}
+
+// Bytes the matrix needs for count stops: every tile on or below the diagonal is stored in full
+qint64 DistanceMatrix::MemoryUsage(int count){
+    qint64 tiles = (count + tileSize - 1) / tileSize;
+    return tiles * (tiles + 1) / 2 * tileSize * tileSize * (qint64)sizeof(float);
+}
+
+// Computes the distances between all points (x[i], y[i]); the tiles are split between the threads. The
+// matrix may take at most maxMemory bytes, so all offsets into it fit into an int.
+void DistanceMatrix::Build(const QVector<double> &x, const QVector<double> &y, int threadCount){
+    Q_ASSERT(MemoryUsage(x.count()) <= maxMemory);
+    count = x.count();
+    int tiles = (count + tileSize - 1) / tileSize;
+    int tileCount = tiles * (tiles + 1) / 2;
+    values.resize((int)(MemoryUsage(count) / sizeof(float)));
+    float *data = values.data(); // detach once, before the threads write to it (the padding of the last tiles is never read)
+    const double *xs = x.constData(), *ys = y.constData();
+
+    ParallelFor(tileCount, threadCount, [&](int begin, int end, int){
+        // Row of the first tile of the chunk, the following tiles are found by walking along the rows
+        int tileRow = (int)((sqrt(8.0 * begin + 1) - 1) / 2);
+        while((qint64)tileRow * (tileRow + 1) / 2 > begin) tileRow--;
+        while((qint64)(tileRow + 1) * (tileRow + 2) / 2 <= begin) tileRow++;
+        int tileColumn = begin - tileRow * (tileRow + 1) / 2;
+
+        for(int tile = begin; tile < end; tile++){
+            float *value = data + (qint64)tile * tileSize * tileSize;
+            int rowEnd = qMin(tileSize, count - tileRow * tileSize);
+            int columnEnd = qMin(tileSize, count - tileColumn * tileSize);
+            for(int i = 0; i < rowEnd; i++){
+                double ax = xs[tileRow * tileSize + i], ay = ys[tileRow * tileSize + i];
+                const double *bx = xs + tileColumn * tileSize, *by = ys + tileColumn * tileSize;
+                for(int j = 0; j < columnEnd; j++)
+                    value[i * tileSize + j] = (float)sqrt((ax - bx[j]) * (ax - bx[j]) + (ay - by[j]) * (ay - by[j]));
+            }
+            if(++tileColumn > tileRow){
+                tileRow++;
+                tileColumn = 0;
+            }
+        }
+    });
+}
+
+// Releases the memory of the matrix
+void DistanceMatrix::Clear(){
+    values.clear();
+    values.squeeze();
+    count = 0;
+}
+
+// Forgets the distances but keeps the memory, which the next Build() of at most as many stops reuses
+void DistanceMatrix::Reset(){
+    values.clear();
+    count = 0;
+}
@@ -0,0 +1,35 @@
+#ifndef DISTANCEMATRIX_H
+#define DISTANCEMATRIX_H
+
+#include <QVector>
+
+// Precomputed Euclidean distances between all stops, stored as float. Only the lower triangle is kept:
+// it is cut into square tiles of tileSize x tileSize stops that lie one after another in memory, so the
+// distances between two groups of nearby stop indices share a few cache lines.
+class DistanceMatrix
+{
+public:
+    DistanceMatrix();
+    static const qint64 maxMemory = ((qint64)1 << 31) - (1 << 20); // largest matrix in bytes (a Qt 5 container holds less than 2 GB)
+    static qint64 MemoryUsage(int count); // bytes the matrix needs for count stops
+    void Build(const QVector<double> &x, const QVector<double> &y, int threadCount = 0); // fills the matrix in parallel (at most maxMemory bytes)
+    void Clear(); // releases the matrix
+    void Reset(); // forgets the distances, keeps the memory for the next Build()
+    bool IsEmpty() const { return count == 0; } // true if nothing has been built
+    int Count() const { return count; } // number of stops
+    float At(int a, int b) const { // distance between stop a and stop b
+        if(a < b)
+            qSwap(a, b);
+        int tileRow = a >> tileShift, tileColumn = b >> tileShift;
+        qint64 tile = (qint64)tileRow * (tileRow + 1) / 2 + tileColumn;
+        return values.at((int)((tile << (2 * tileShift)) + ((a & tileMask) << tileShift) + (b & tileMask)));
+    }
+private:
+    static const int tileShift = 6; // tiles of 64 x 64 stops (16 KB)
+    static const int tileSize = 1 << tileShift;
+    static const int tileMask = tileSize - 1;
+    QVector<float> values; // tiles of the lower triangle, row of tiles by row of tiles
+    int count;
+};
+
+#endif // DISTANCEMATRIX_H
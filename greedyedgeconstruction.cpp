@@ -0,0 +1,115 @@
+#include "greedyedgeconstruction.h"
+#include "parallelsort.h"
+#include "spatialindex.h"
+
+GreedyEdgeConstruction::GreedyEdgeConstruction(const DistanceFunction &distance, const CandidateNeighbors &candidates, int threadCount):
+    distance(distance),
+    candidates(candidates),
+    threadCount(threadCount),
+    paths(0)
+{
+
+}
+
+// Greedy matching on the candidate edges, then a nearest neighbor tour over the path ends
+double GreedyEdgeConstruction::Construct(const QVector<int> &stops, QVector<int> &route){
+    route.clear();
+    paths = 0;
+    if(stops.isEmpty())
+        return 0;
+
+    // Every candidate pair once, shortest first
+    QVector<Edge> edges;
+    for(int stop : stops){
+        for(const int *neighbor = candidates.Begin(stop); neighbor != candidates.End(stop); ++neighbor){
+            Edge edge;
+            edge.length = distance(stop, *neighbor);
+            edge.a = qMin(stop, *neighbor);
+            edge.b = qMax(stop, *neighbor);
+            edges.append(edge);
+        }
+    }
+    ParallelSort(edges, threadCount);
+
+    link.fill(-1, 2 * distance.Count());
+    parent.resize(distance.Count());
+    for(int stop : stops)
+        parent[stop] = stop;
+    for(int i = 0; i < edges.count(); i++){
+        const Edge &edge = edges.at(i);
+        if(i > 0 && edge.a == edges.at(i - 1).a && edge.b == edges.at(i - 1).b)
+            continue;
+        if(link.at(2 * edge.a + 1) >= 0 || link.at(2 * edge.b + 1) >= 0)
+            continue;
+        int rootA = Find(edge.a), rootB = Find(edge.b);
+        if(rootA == rootB)
+            continue;
+        parent[rootA] = rootB;
+        link[2 * edge.a + (link.at(2 * edge.a) < 0 ? 0 : 1)] = edge.b;
+        link[2 * edge.b + (link.at(2 * edge.b) < 0 ? 0 : 1)] = edge.a;
+    }
+
+    // Path ends: stops with less than two edges (a single stop is a path with both ends on it)
+    QVector<int> ends;
+    QVector<double> endX, endY;
+    for(int stop : stops){
+        if(link.at(2 * stop + 1) < 0){
+            ends.append(stop);
+            endX.append(distance.X(stop));
+            endY.append(distance.Y(stop));
+        }
+    }
+    QVector<int> endSlot(distance.Count(), -1);
+    for(int i = 0; i < ends.count(); i++)
+        endSlot[ends.at(i)] = i;
+
+    // From the end of the current path to the closest end of another path
+    SpatialIndex index;
+    index.Build(endX, endY);
+    int end = ends.at(0);
+    while(end >= 0){
+        int last = OtherEnd(end);
+        index.Remove(endSlot.at(end));
+        index.Remove(endSlot.at(last));
+        AppendPath(end, route);
+        paths++;
+        int next = index.Nearest(distance.X(last), distance.Y(last));
+        end = next < 0 ? -1 : ends.at(next);
+    }
+
+    std::rotate(route.begin(), std::find(route.begin(), route.end(), stops.at(0)), route.end());
+    return distance.RouteLength(route);
+}
+
+// Representative of the path of a stop (with path halving)
+int GreedyEdgeConstruction::Find(int stop){
+    while(parent.at(stop) != stop){
+        parent[stop] = parent.at(parent.at(stop));
+        stop = parent.at(stop);
+    }
+    return stop;
+}
+
+// Appends the stops of a path from one of its ends to the other
+void GreedyEdgeConstruction::AppendPath(int end, QVector<int> &route) const{
+    int previous = -1;
+    for(int stop = end; stop >= 0; ){
+        route.append(stop);
+        int next = link.at(2 * stop) != previous ? link.at(2 * stop) : link.at(2 * stop + 1);
+        previous = stop;
+        stop = next;
+    }
+}
+
+// Walks a path from one end to the other
+int GreedyEdgeConstruction::OtherEnd(int end) const{
+    int previous = -1;
+    int stop = end;
+    while(true){
+        int next = link.at(2 * stop) != previous ? link.at(2 * stop) : link.at(2 * stop + 1);
+        if(next < 0)
+            return stop;
+        previous = stop;
+        stop = next;
+    }
+}
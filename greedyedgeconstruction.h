@@ -0,0 +1,38 @@
+#ifndef GREEDYEDGECONSTRUCTION_H
+#define GREEDYEDGECONSTRUCTION_H
+
+#include <QVector>
+#include "distancefunction.h"
+#include "candidateneighbors.h"
+
+// Greedy edge construction: the candidate edges are taken shortest first (sorted in parallel) as long as
+// both stops have less than two edges and the edge does not close a cycle. This leaves paths of stops
+// without the long return edges of the nearest neighbor tour. The paths are then joined into one tour:
+// from the end of the current path to the nearest end of a remaining path.
+class GreedyEdgeConstruction
+{
+public:
+    GreedyEdgeConstruction(const DistanceFunction &distance, const CandidateNeighbors &candidates, int threadCount = 0);
+    // Fills route with a closed tour through the stops that starts with the first given stop, returns its length
+    double Construct(const QVector<int> &stops, QVector<int> &route);
+    int Paths() const { return paths; } // number of paths the greedy edges left for the last tour
+private:
+    struct Edge {
+        double length;
+        int a, b; // stops of the edge (a < b)
+        bool operator<(const Edge &other) const {
+            return length < other.length || (length == other.length && (a < other.a || (a == other.a && b < other.b)));
+        }
+    };
+    const DistanceFunction &distance;
+    const CandidateNeighbors &candidates;
+    int threadCount;
+    int paths;
+    QVector<int> link; // two neighbors of every stop on its path (-1: none)
+    QVector<int> parent; // union-find forest of the paths
+    int Find(int stop); // representative of the path of a stop
+    void AppendPath(int end, QVector<int> &route) const; // appends the path that starts at the end stop
+    int OtherEnd(int end) const; // stop at the other end of a path
+};
+
+#endif // GREEDYEDGECONSTRUCTION_H
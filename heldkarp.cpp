@@ -0,0 +1,129 @@
+#include "heldkarp.h"
+#include "parallelfor.h"
+
+#include <limits>
+
+HeldKarp::HeldKarp(const DistanceFunction &distance, const StopStore &stops, int threadCount):
+    distance(distance),
+    stops(stops),
+    threadCount(threadCount)
+{
+
+}
+
+// Bytes of the table: one float per stop set and end stop
+qint64 HeldKarp::MemoryUsage(int count){
+    return ((qint64)1 << count) * count * (qint64)sizeof(float);
+}
+
+// Fills the table layer by layer and walks back from the best end stop
+double HeldKarp::Solve(const QVector<int> &tourStops, QVector<int> &route) const{
+    int count = tourStops.count();
+    route.clear();
+    route.append(0);
+    if(count > maxStops)
+        return -1;
+    if(count == 0)
+        return 0;
+
+    // Local distances (index count is the depot) and the pickup every stop needs in its set
+    const float infinity = std::numeric_limits<float>::infinity();
+    QVector<float> local((count + 1) * (count + 1));
+    for(int i = 0; i <= count; i++){
+        for(int j = 0; j <= count; j++)
+            local[i * (count + 1) + j] = distance(i == count ? 0 : tourStops.at(i), j == count ? 0 : tourStops.at(j));
+    }
+    QVector<quint32> required(count, 0);
+    for(int j = 0; j < count; j++){
+        int stop = tourStops.at(j);
+        if(stops.kind.at(stop) == requestDeliveryStop){
+            int pickup = tourStops.indexOf(stops.partner.at(stop));
+            if(pickup >= 0)
+                required[j] = 1u << pickup;
+        }
+    }
+
+    quint32 full = (1u << count) - 1;
+    QVector<float> cost(full + 1 == 0 ? 0 : (int)((full + 1) * (quint64)count), infinity);
+    float *table = cost.data(); // detach once, before the threads write to it
+    const float *d = local.constData();
+    for(int j = 0; j < count; j++){
+        if(required.at(j) == 0)
+            table[(1u << j) * count + j] = d[count * (count + 1) + j];
+    }
+
+    // Sets with size stops only read sets with size - 1 stops
+    QVector<quint32> layer;
+    for(int size = 2; size <= count; size++){
+        // All sets with size stops in increasing order (Gosper's hack)
+        layer.clear();
+        for(quint32 set = (1u << size) - 1; set <= full; ){
+            layer.append(set);
+            quint32 lowest = set & (~set + 1);
+            quint32 ripple = set + lowest;
+            if(ripple == 0 || ripple > full + 1)
+                break;
+            set = (((ripple ^ set) >> 2) / lowest) | ripple;
+        }
+
+        ParallelFor(layer.count(), threadCount, [&](int begin, int end, int){
+            for(int l = begin; l < end; l++){
+                quint32 set = layer.at(l);
+                for(int j = 0; j < count; j++){
+                    quint32 previous = set & ~(1u << j);
+                    if(previous == set || (required.at(j) & previous) != required.at(j))
+                        continue;
+                    const float *row = table + (quint64)previous * count;
+                    float best = infinity;
+                    for(int i = 0; i < count; i++){
+                        float value = row[i] + d[i * (count + 1) + j];
+                        if(value < best)
+                            best = value;
+                    }
+                    table[(quint64)set * count + j] = best;
+                }
+            }
+        });
+    }
+
+    // Close the route at the best end stop, then follow the table back to the depot
+    int last = -1;
+    float best = infinity;
+    for(int j = 0; j < count; j++){
+        float value = table[(quint64)full * count + j] + d[j * (count + 1) + count];
+        if(value < best){
+            best = value;
+            last = j;
+        }
+    }
+    if(last < 0)
+        return -1;
+
+    // The predecessor is the stop that minimizes the sum again instead of one whose sum equals the table
+    // entry: with x87 float math the sum keeps extended precision, so an equality test can fail for all
+    // stops. Stops outside the set and infeasible ends are infinite in the table and never chosen.
+    QVector<int> reversed;
+    quint32 set = full;
+    for(int j = last; j >= 0; ){
+        reversed.append(tourStops.at(j));
+        quint32 previous = set & ~(1u << j);
+        int next = -1;
+        if(previous != 0){
+            const float *row = table + (quint64)previous * count;
+            float nextBest = infinity;
+            for(int i = 0; i < count; i++){
+                float value = row[i] + d[i * (count + 1) + j];
+                if(value < nextBest){
+                    nextBest = value;
+                    next = i;
+                }
+            }
+        }
+        set = previous;
+        j = next;
+    }
+    Q_ASSERT(set == 0 && reversed.count() == count);
+    for(int i = reversed.count() - 1; i >= 0; i--)
+        route.append(reversed.at(i));
+    return distance.RouteLength(route);
+}
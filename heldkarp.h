@@ -0,0 +1,28 @@
+#ifndef HELDKARP_H
+#define HELDKARP_H
+
+#include <QVector>
+#include "distancefunction.h"
+#include "stopstore.h"
+
+// Exact solver for small tours (Held-Karp dynamic programming over subsets of the stops). cost[S][j] is
+// the shortest path that starts at the depot, visits the stop set S and ends at stop j in S. The entries
+// of one set lie next to each other, and the sets are processed layer by layer (by their number of
+// stops) because a layer only reads the layer before; every layer is split between the threads.
+// Requests are respected: a delivery can only be added to a set that contains its pickup.
+class HeldKarp
+{
+public:
+    static const int maxStops = 21; // largest number of stops besides the depot (the table takes 176 MB)
+    HeldKarp(const DistanceFunction &distance, const StopStore &stops, int threadCount = 0);
+    static qint64 MemoryUsage(int count); // bytes of the table for count stops
+    // Shortest closed route from the depot through the given stops, route starts with the depot;
+    // returns its length or -1 if there are too many stops
+    double Solve(const QVector<int> &tourStops, QVector<int> &route) const;
+private:
+    const DistanceFunction &distance;
+    const StopStore &stops;
+    int threadCount;
+};
+
+#endif // HELDKARP_H
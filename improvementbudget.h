@@ -0,0 +1,42 @@
+#ifndef IMPROVEMENTBUDGET_H
+#define IMPROVEMENTBUDGET_H
+
+#include <QElapsedTimer>
+#include <atomic>
+
+// Limits the work of an improvement stage. A stage stops after maxIterations applied improving
+// moves or after timeLimit milliseconds, whatever comes first, and keeps the route it has reached.
+// Another thread can end it earlier through the stop flag.
+struct ImprovementBudget
+{
+    int maxIterations; // maximum number of improving moves (-1: unlimited)
+    qint64 timeLimit; // maximum runtime in milliseconds (-1: unlimited)
+    const std::atomic<bool> *stop; // the stage ends as soon as this is set (nullptr: never)
+    ImprovementBudget(int maxIterations = -1, qint64 timeLimit = -1, const std::atomic<bool> *stop = nullptr):
+        maxIterations(maxIterations), timeLimit(timeLimit), stop(stop) {}
+};
+
+// Keeps track of how much of a budget is used up
+class BudgetTracker
+{
+public:
+    BudgetTracker(const ImprovementBudget &budget): budget(budget), iterations(0) { timer.start(); }
+    void CountIterations(int count = 1) { iterations += count; } // count improving moves that were applied
+    bool Exhausted() const { // true if no further move may be applied
+        return (budget.maxIterations >= 0 && iterations >= budget.maxIterations) ||
+               (budget.timeLimit >= 0 && timer.elapsed() >= budget.timeLimit) ||
+               (budget.stop && budget.stop->load(std::memory_order_relaxed));
+    }
+    int Iterations() const { return iterations; } // improving moves applied so far
+    ImprovementBudget Remaining() const { // what is left of the budget for a following stage
+        return ImprovementBudget(budget.maxIterations < 0 ? -1 : qMax(0, budget.maxIterations - iterations),
+                                 budget.timeLimit < 0 ? -1 : qMax<qint64>(0, budget.timeLimit - timer.elapsed()),
+                                 budget.stop);
+    }
+private:
+    ImprovementBudget budget;
+    QElapsedTimer timer;
+    int iterations;
+};
+
+#endif // IMPROVEMENTBUDGET_H
@@ -0,0 +1,21 @@
+#ifndef IMPROVEMENTSCRATCH_H
+#define IMPROVEMENTSCRATCH_H
+
+#include <QVector>
+
+// Work arrays of the single route improvement stages. A stage that is given a scratch swaps its arrays
+// with it at the start of a run and back at the end, so a caller that improves many routes one after
+// another allocates them once: the stages fill() them, which keeps the capacity.
+struct ImprovementScratch
+{
+    QVector<int> position; // position of every stop in the tour
+    QVector<int> queue; // ring buffer of the stops whose don't-look bit is off
+    QVector<bool> queued; // don't-look bit cleared (stop is in the queue)
+    void Swap(QVector<int> &position, QVector<int> &queue, QVector<bool> &queued) { // exchanges the arrays with those of a stage
+        this->position.swap(position);
+        this->queue.swap(queue);
+        this->queued.swap(queued);
+    }
+};
+
+#endif // IMPROVEMENTSCRATCH_H
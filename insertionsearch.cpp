@@ -0,0 +1,136 @@
+#include "insertionsearch.h"
+
+#include <algorithm>
+#include <limits>
+
+static const int longEdgeCount = 64; // number of edges that are checked directly
+static const int firstNeighborCount = 16; // stops around the inserted stop that are looked at first
+
+InsertionSearch::InsertionSearch(const DistanceFunction &distance, const QVector<double> &x, const QVector<double> &y):
+    distance(distance),
+    x(x),
+    y(y),
+    routes(nullptr),
+    edgeLimit(0)
+{
+
+}
+
+// Indexes the routed stops and collects the longest edges
+void InsertionSearch::Build(const QVector<QVector<int>> &routes){
+    this->routes = &routes;
+    int count = x.count();
+    routeOf.fill(-1, count);
+    positionOf.fill(-1, count);
+    QVector<double> edgeLength;
+    for(int r = 0; r < routes.count(); r++){
+        const QVector<int> &route = routes.at(r);
+        for(int i = 0; i < route.count(); i++){
+            if(route.at(i) != 0){
+                routeOf[route.at(i)] = r;
+                positionOf[route.at(i)] = i;
+            }
+            if(i > 0)
+                edgeLength.append(distance(route.at(i - 1), route.at(i)));
+        }
+    }
+
+    index.Build(x, y);
+    for(int stop = 0; stop < count; stop++){
+        if(routeOf.at(stop) < 0)
+            index.Remove(stop);
+    }
+
+    // The edges longer than the limit and the edges at the depot: the depot is not in the index, so the
+    // bound of the search does not hold for them
+    edgeLimit = 0;
+    if(edgeLength.count() > longEdgeCount){
+        QVector<double> sorted = edgeLength;
+        std::nth_element(sorted.begin(), sorted.end() - longEdgeCount - 1, sorted.end());
+        edgeLimit = *(sorted.end() - longEdgeCount - 1);
+    }
+    longEdges.clear();
+    int edge = 0;
+    for(int r = 0; r < routes.count(); r++){
+        const QVector<int> &route = routes.at(r);
+        for(int i = 1; i < route.count(); i++, edge++){
+            if(edgeLength.at(edge) > edgeLimit || route.at(i - 1) == 0 || route.at(i) == 0)
+                longEdges.append(qMakePair(r, i));
+        }
+    }
+}
+
+// Cheapest insertion of a stop into the routes
+InsertionSearch::Insertion InsertionSearch::Cheapest(int stop) const{
+    Insertion best = {-1, -1, std::numeric_limits<double>::infinity()};
+    for(const QPair<int, int> &edge : longEdges)
+        Consider(edge.first, edge.second, stop, best);
+
+    // The edges next to the stops around the new stop, with more stops until the remaining ones are too far away
+    QVector<int> nearest;
+    for(int k = firstNeighborCount; ; k *= 2){
+        index.KNearest(x.at(stop), y.at(stop), k, nearest);
+        for(int neighbor : nearest){
+            int route = routeOf.at(neighbor), position = positionOf.at(neighbor);
+            Consider(route, position, stop, best);
+            Consider(route, position + 1, stop, best);
+        }
+        if(nearest.count() < k)
+            break;
+        double radius = distance(nearest.last(), stop);
+        if(2 * radius - edgeLimit > best.increase)
+            break;
+    }
+    return best;
+}
+
+// Takes a stop into the search that the caller has just inserted into the routes as given by the insertion
+// (found by Cheapest()), so that further stops can be inserted without a new Build(). Stops that were not
+// part of the coordinates at Build() have to be added in index order. The index finds its place in
+// O(log n); the stops behind it in its route move one position back.
+void InsertionSearch::Insert(int stop, const Insertion &insertion){
+    const QVector<int> &route = routes->at(insertion.route);
+    if(stop < routeOf.count()){
+        index.Restore(stop);
+    }else{
+        routeOf.append(-1);
+        positionOf.append(-1);
+        index.Insert(x.at(stop), y.at(stop));
+    }
+    routeOf[stop] = insertion.route;
+    for(int i = insertion.position; i < route.count(); i++){
+        if(route.at(i) != 0)
+            positionOf[route.at(i)] = i;
+    }
+
+    // The edge in front of the stop keeps its place in the list, all later edges of the route move back
+    int position = insertion.position;
+    bool listed = false;
+    for(QPair<int, int> &edge : longEdges){
+        if(edge.first != insertion.route)
+            continue;
+        if(edge.second > position)
+            edge.second++;
+        else if(edge.second == position)
+            listed = true;
+    }
+    if(!listed && (route.at(position - 1) == 0 || distance(route.at(position - 1), stop) > edgeLimit))
+        longEdges.append(qMakePair(insertion.route, position));
+    if(route.at(position + 1) == 0 || distance(stop, route.at(position + 1)) > edgeLimit)
+        longEdges.append(qMakePair(insertion.route, position + 1));
+}
+
+// Checks inserting stop between the positions position - 1 and position of a route
+void InsertionSearch::Consider(int route, int position, int stop, Insertion &best) const{
+    const QVector<int> &stops = routes->at(route);
+    if(position < 1 || position >= stops.count())
+        return;
+    int a = stops.at(position - 1), b = stops.at(position);
+    double increase = distance(a, stop) + distance(stop, b) - distance(a, b);
+    if(increase < best.increase || (increase == best.increase &&
+                                    (route < best.route || (route == best.route && position < best.position)))){
+        best.route = route;
+        best.position = position;
+        best.increase = increase;
+    }
+}
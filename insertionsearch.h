@@ -0,0 +1,38 @@
+#ifndef INSERTIONSEARCH_H
+#define INSERTIONSEARCH_H
+
+#include <QVector>
+#include <QPair>
+#include "distancefunction.h"
+#include "spatialindex.h"
+
+// Finds the cheapest position to insert a stop into a set of routes (depot at both ends) without
+// looking at every edge. Inserting p into the edge (a, b) costs at least 2 r - d(a, b) if a and b are
+// both r or farther away from p. So only the few longest edges and the edges at the depot (which is not
+// indexed) are checked directly; all other edges are reached through the stops around p, and the search
+// stops as soon as no stop that is farther away can give a cheaper insertion. The result is the same as
+// that of a scan over all edges.
+class InsertionSearch
+{
+public:
+    struct Insertion {
+        int route; // route that gets the stop
+        int position; // position of the stop in that route after the insertion
+        double increase; // additional route length
+    };
+    InsertionSearch(const DistanceFunction &distance, const QVector<double> &x, const QVector<double> &y);
+    void Build(const QVector<QVector<int>> &routes); // prepares the search on the routes (they may only change by Insert())
+    Insertion Cheapest(int stop) const; // cheapest insertion of a stop (lowest route and position on ties)
+    void Insert(int stop, const Insertion &insertion); // updates the search after the stop was inserted into the routes
+private:
+    const DistanceFunction &distance;
+    const QVector<double> &x, &y;
+    const QVector<QVector<int>> *routes;
+    SpatialIndex index; // holds the stops of the routes (without the depot)
+    QVector<int> routeOf, positionOf; // route and position of every routed stop
+    QVector<QPair<int, int>> longEdges; // (route, position) of the edges that are checked directly
+    double edgeLimit; // all other edges are at most this long
+    void Consider(int route, int position, int stop, Insertion &best) const; // checks the edge in front of position
+};
+
+#endif // INSERTIONSEARCH_H
@@ -0,0 +1,280 @@
+#include "linkernighan.h"
+
+#include <QVarLengthArray>
+#include <algorithm>
+#include <math.h>
+
+static const double minimumGain = 1e-10; // smaller gains are treated as rounding noise
+static const int maxDepth = 50; // maximum number of flips of one move
+static const int breadth[] = {5, 3}; // candidates tried on the first levels (1 on deeper levels)
+static const int maxKickSegment = 50; // maximum length of the segments swapped by a kick
+
+LinKernighan::LinKernighan(const DistanceFunction &distance, const CandidateNeighbors &candidates, const ImprovementBudget &budget,
+                           SplitRandom random):
+    distance(distance),
+    candidates(candidates),
+    budget(budget),
+    stream(nullptr),
+    scratch(nullptr),
+    random(random),
+    iterations(0),
+    queueHead(0),
+    queueSize(0),
+    journaling(false),
+    bestGain(0),
+    bestDepth(0),
+    maxReversal(0)
+{
+
+}
+
+// Runs the chained search until the budget is used up and returns the length of the best route.
+// Without any limit in the budget one kick per stop is made.
+double LinKernighan::Optimize(QVector<int> &route){
+    iterations = 0;
+    if(route.count() < 5)
+        return distance.RouteLength(route);
+
+    maxReversal = std::max(1000, 25 * (int)sqrt((double)route.count()));
+    ImprovementBudget limit = budget;
+    if(limit.maxIterations < 0 && limit.timeLimit < 0)
+        limit.maxIterations = route.count();
+    BudgetTracker tracker(limit);
+
+    tour.swap(route);
+    if(scratch)
+        scratch->Swap(position, queue, queued);
+    position.fill(-1, distance.Count());
+    for(int i = 0; i < tour.count(); i++)
+        position[tour.at(i)] = i;
+    queue.fill(0, tour.count());
+    queued.fill(false, distance.Count());
+    queueHead = 0; queueSize = 0;
+    for(int stop : tour)
+        Push(stop);
+
+    // The first descent only improves, so the route is always the best one found so far
+    journaling = false;
+    double bestLength = distance.RouteLength(tour) - LocalSearch(tracker);
+
+    // Kick the route and repair it; keep the result if it is not longer, otherwise return to the best route
+    if(tour.count() >= 8){
+        while(!tracker.Exhausted()){
+            journal.clear();
+            journaling = true;
+            double length = bestLength + Kick();
+            length -= LocalSearch(tracker);
+            journaling = false;
+            if(length <= bestLength){
+                bestLength = length;
+                if(stream && stream->Due())
+                    stream->Publish(tour, bestLength);
+            }else
+                RevertJournal();
+            tracker.CountIterations();
+        }
+    }
+    iterations = tracker.Iterations();
+    journal.clear();
+
+    if(scratch)
+        scratch->Swap(position, queue, queued);
+    route.swap(tour);
+    return distance.RouteLength(route);
+}
+
+// Applies improving moves until every don't-look bit is set or the time is up; returns the total gain
+double LinKernighan::LocalSearch(const BudgetTracker &tracker){
+    double gain = 0;
+    while(queueSize > 0 && !tracker.Exhausted()){
+        int a = queue.at(queueHead);
+        queueHead = (queueHead + 1) % queue.count();
+        queueSize--;
+        queued[a] = false;
+        double stopGain = ImproveStop(a);
+        if(stopGain > 0){
+            gain += stopGain;
+            Push(a);
+            // Only the first descent improves the best route; after a kick the route may still be longer
+            if(!journaling && stream && stream->Due())
+                stream->Publish(tour, distance.RouteLength(tour));
+        }
+    }
+    // Stops left in the queue are looked at after the next kick
+    return gain;
+}
+
+// Searches a move that starts by removing one of the two route edges at t1
+double LinKernighan::ImproveStop(int t1){
+    for(int side = 0; side < 2; side++){
+        int t2 = side == 0 ? Next(t1) : Prev(t1);
+        flips.clear();
+        added.clear();
+        bestGain = minimumGain;
+        bestDepth = 0;
+        if(Step(0, t1, t2, distance(t1, t2))){
+            // Only the flips up to the best closed tour are kept
+            while(flips.count() > bestDepth){
+                Flip flip = flips.last();
+                flips.removeLast();
+                Reverse(flip.from, flip.to);
+            }
+            // Every stop that got a new edge has to be looked at again
+            for(int stop : added)
+                Push(stop);
+            Push(t1); Push(t2);
+            return bestGain;
+        }
+    }
+    return 0;
+}
+
+// Extends the move: the edge (t1, t2) is open, gain is what the move has gained so far without closing it.
+// Adds (t2, t3) for a candidate t3, removes (t3, t4) and closes the tour with (t4, t1).
+bool LinKernighan::Step(int level, int t1, int t2, double gain){
+    struct Alternative { double gain; int t3, t4; };
+    QVarLengthArray<Alternative, 16> alternatives;
+    bool forward = Next(t1) == t2;
+    for(const int *candidate = candidates.Begin(t2); candidate != candidates.End(t2); ++candidate){
+        int t3 = *candidate;
+        double partialGain = gain - distance(t2, t3);
+        // Candidates are sorted, so no later one can keep the gain positive
+        if(partialGain <= minimumGain)
+            break;
+        if(t3 == Next(t2) || t3 == Prev(t2))
+            continue;
+        int t4 = forward ? Prev(t3) : Next(t3);
+        // Edges added by this move may not be removed again
+        bool wasAdded = false;
+        for(int i = 0; i < added.count(); i += 2){
+            if((added.at(i) == t3 && added.at(i + 1) == t4) || (added.at(i) == t4 && added.at(i + 1) == t3))
+                wasAdded = true;
+        }
+        if(wasAdded)
+            continue;
+        // Long tentative flips cost more than they are likely to bring
+        if(ReversalLength(forward ? position.at(t2) : position.at(t4), forward ? position.at(t4) : position.at(t2)) > maxReversal)
+            continue;
+        Alternative alternative = {partialGain + distance(t3, t4), t3, t4};
+        alternatives.append(alternative);
+    }
+    std::sort(alternatives.begin(), alternatives.end(),
+              [](const Alternative &a, const Alternative &b){ return a.gain > b.gain; });
+
+    int tries = std::min<int>(alternatives.size(), level < 2 ? breadth[level] : 1);
+    for(int i = 0; i < tries; i++){
+        const Alternative &alternative = alternatives[i];
+        MakeFlip(t1, t2, alternative.t4);
+        added.append(t2); added.append(alternative.t3);
+
+        double closedGain = alternative.gain - distance(alternative.t4, t1);
+        if(closedGain > bestGain){
+            bestGain = closedGain;
+            bestDepth = flips.count();
+        }
+        if(level + 1 < maxDepth && Step(level + 1, t1, alternative.t4, alternative.gain))
+            return true;
+        // The deeper levels found nothing better, but this level closes with a gain
+        if(bestGain > minimumGain)
+            return true;
+
+        Flip flip = flips.last();
+        flips.removeLast();
+        Reverse(flip.from, flip.to);
+        added.removeLast(); added.removeLast();
+    }
+    return false;
+}
+
+// 2-opt flip that replaces the edges (t1, t2), (t3, t4) by (t2, t3), (t4, t1); t3 is the neighbor of t4
+// on the far side from t1
+void LinKernighan::MakeFlip(int t1, int t2, int t4){
+    Flip flip;
+    if(Next(t1) == t2){
+        // t1 t2 .. t4 t3 -> t1 t4 .. t2 t3
+        flip.from = position.at(t2); flip.to = position.at(t4);
+    }else{
+        // t3 t4 .. t2 t1 -> t3 t2 .. t4 t1
+        flip.from = position.at(t4); flip.to = position.at(t2);
+    }
+    Reverse(flip.from, flip.to);
+    flips.append(flip);
+}
+
+// Reverses the tour between two positions. The shorter side of the cycle is reversed, which gives
+// the same cycle; calling it again with the same positions undoes it.
+void LinKernighan::Reverse(int from, int to){
+    if(journaling){
+        Flip flip = {from, to};
+        journal.append(flip);
+    }
+    int count = tour.count();
+    int length = (to - from + count) % count + 1;
+    if(2 * length > count){
+        int oldFrom = from;
+        from = (to + 1) % count;
+        to = (oldFrom - 1 + count) % count;
+        length = count - length;
+    }
+    for(int i = 0; i < length / 2; i++){
+        int first = tour.at(from), second = tour.at(to);
+        tour[from] = second; position[second] = from;
+        tour[to] = first; position[first] = to;
+        from = from + 1 == count ? 0 : from + 1;
+        to = to == 0 ? count - 1 : to - 1;
+    }
+}
+
+// Number of stops a reversal between two positions moves (the shorter side of the cycle)
+int LinKernighan::ReversalLength(int from, int to) const{
+    int count = tour.count();
+    int length = (to - from + count) % count + 1;
+    return std::min(length, count - length);
+}
+
+// Swaps two short neighboring segments: p [B] [C] q -> p [C] [B] q (done by three reversals
+// that are short enough to never flip the other side of the cycle)
+double LinKernighan::Kick(){
+    int count = tour.count();
+    int maxSegment = std::min(maxKickSegment, count / 4);
+    int start = random.Uniform(0, count - 1);
+    int lengthB = random.Uniform(1, maxSegment);
+    int lengthC = random.Uniform(1, maxSegment);
+
+    int p = tour.at((start - 1 + count) % count);
+    int b1 = tour.at(start), b2 = tour.at((start + lengthB - 1) % count);
+    int c1 = tour.at((start + lengthB) % count), c2 = tour.at((start + lengthB + lengthC - 1) % count);
+    int q = tour.at((start + lengthB + lengthC) % count);
+    double delta = distance(p, c1) + distance(c2, b1) + distance(b2, q)
+                 - distance(p, b1) - distance(b2, c1) - distance(c2, q);
+
+    Reverse(start, (start + lengthB + lengthC - 1) % count);
+    Reverse(start, (start + lengthC - 1) % count);
+    Reverse((start + lengthC) % count, (start + lengthB + lengthC - 1) % count);
+
+    Push(p); Push(b1); Push(b2); Push(c1); Push(c2); Push(q);
+    return delta;
+}
+
+// Returns to the last accepted route
+void LinKernighan::RevertJournal(){
+    journaling = false;
+    for(int i = journal.count() - 1; i >= 0; i--)
+        Reverse(journal.at(i).from, journal.at(i).to);
+    journal.clear();
+    // Stops that were still queued belong to the rejected route
+    while(queueSize > 0){
+        queued[queue.at(queueHead)] = false;
+        queueHead = (queueHead + 1) % queue.count();
+        queueSize--;
+    }
+}
+
+// Clears the don't-look bit of a stop so that it is looked at again
+void LinKernighan::Push(int stop){
+    if(queued.at(stop))
+        return;
+    queued[stop] = true;
+    queue[(queueHead + queueSize) % queue.count()] = stop;
+    queueSize++;
+}
@@ -0,0 +1,62 @@
+#ifndef LINKERNIGHAN_H
+#define LINKERNIGHAN_H
+
+#include <QVector>
+#include "distancefunction.h"
+#include "candidateneighbors.h"
+#include "improvementbudget.h"
+#include "routestream.h"
+#include "improvementscratch.h"
+#include "splitrandom.h"
+
+// Chained Lin-Kernighan style local search on a closed route. An improving move is a variable
+// depth sequence of 2-opt flips; the first levels try several candidates (sequential 3-opt moves
+// are covered), deeper levels follow the best candidate only. Flips that would reverse long parts of
+// the route are not tried. When no improving move is left the
+// route is perturbed by a local double-bridge kick and improved again. The search runs until the
+// budget is used up (time limit: wall clock deadline, iterations: number of kicks) and returns the
+// best route found so far.
+class LinKernighan
+{
+public:
+    LinKernighan(const DistanceFunction &distance, const CandidateNeighbors &candidates, const ImprovementBudget &budget,
+                 SplitRandom random = SplitRandom());
+    double Optimize(QVector<int> &route); // improves the closed route in place and returns its length
+    int Iterations() const { return iterations; } // number of kicks of the last run
+    void SetStream(RouteStream *stream) { this->stream = stream; } // publishes the improving route (nullptr: never)
+    void SetScratch(ImprovementScratch *scratch) { this->scratch = scratch; } // borrows the work arrays from the scratch (nullptr: own arrays)
+private:
+    struct Flip { int from, to; }; // positions of a reversal, used to undo it
+    const DistanceFunction &distance;
+    const CandidateNeighbors &candidates;
+    ImprovementBudget budget;
+    RouteStream *stream; // receives the best route so far (nullptr: none)
+    ImprovementScratch *scratch; // lends the work arrays of a run (nullptr: the stage's own)
+    SplitRandom random; // random numbers for the kicks
+    int iterations;
+    QVector<int> tour; // route that is improved
+    QVector<int> position; // position of every stop in the tour
+    QVector<int> queue; // ring buffer of the stops whose don't-look bit is off
+    QVector<bool> queued; // don't-look bit cleared (stop is in the queue)
+    int queueHead, queueSize;
+    QVector<Flip> flips; // flips of the current move
+    QVector<Flip> journal; // all reversals since the last accepted route (to return to it)
+    bool journaling; // reversals are recorded in the journal
+    QVector<int> added; // edges added by the current move (pairs of stops)
+    double bestGain; // best closed gain of the current move
+    int bestDepth; // number of flips that give bestGain
+    int maxReversal; // longest reversal a move may make
+    int Next(int stop) const { return tour.at(position.at(stop) + 1 == tour.count() ? 0 : position.at(stop) + 1); }
+    int Prev(int stop) const { return tour.at(position.at(stop) == 0 ? tour.count() - 1 : position.at(stop) - 1); }
+    double LocalSearch(const BudgetTracker &tracker); // improves until the queue is empty, returns the gain
+    double ImproveStop(int t1); // applies the best move starting at t1, returns its gain
+    bool Step(int level, int t1, int t2, double gain); // extends the current move by one flip
+    void MakeFlip(int t1, int t2, int t4); // replaces (t1, t2), (t3, t4) by (t2, t3), (t4, t1)
+    void Reverse(int from, int to); // reverses the tour between two positions (cyclic, inclusive)
+    int ReversalLength(int from, int to) const; // number of stops moved by a reversal
+    double Kick(); // applies a random local double-bridge, returns the length change
+    void RevertJournal(); // undoes all reversals recorded in the journal
+    void Push(int stop); // clears the don't-look bit of a stop
+};
+
+#endif // LINKERNIGHAN_H
@@ -0,0 +1,191 @@
+#include "nearestkernel.h"
+
+#include <limits>
+
+// The vector kernels have to round exactly like the scalar loop: no fused multiply-add
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NEARESTKERNEL_X86
+#include <immintrin.h>
+#endif
+
+typedef int (*NearestFunction)(const double *xs, const double *ys, int count, double x, double y);
+
+// Scans the points [begin, count) one by one, starting from the best point found so far
+static inline int NearestTail(const double *xs, const double *ys, int begin, int count, double x, double y,
+                              int bestIndex, double bestDistance){
+    for(int i = begin; i < count; i++){
+        double dx = xs[i] - x;
+        double dy = ys[i] - y;
+        double distance = dx * dx + dy * dy;
+        if(distance < bestDistance){
+            bestDistance = distance;
+            bestIndex = i;
+        }
+    }
+    return bestIndex;
+}
+
+// Combines the per lane results of a vector kernel (every lane has seen its indices in ascending order)
+static inline void ReduceLanes(const double *distances, const double *indices, int lanes, int &bestIndex, double &bestDistance){
+    for(int lane = 0; lane < lanes; lane++){
+        int index = (int)indices[lane];
+        if(index < 0)
+            continue;
+        if(distances[lane] < bestDistance || (distances[lane] == bestDistance && index < bestIndex)){
+            bestDistance = distances[lane];
+            bestIndex = index;
+        }
+    }
+}
+
+static int NearestScalar(const double *xs, const double *ys, int count, double x, double y){
+    return NearestTail(xs, ys, 0, count, x, y, -1, std::numeric_limits<double>::infinity());
+}
+
+#ifdef NEARESTKERNEL_X86
+
+// Each kernel keeps several independent accumulators so that the compare/blend chains overlap
+
+__attribute__((target("sse2")))
+static int NearestSse2(const double *xs, const double *ys, int count, double x, double y){
+    const int lanes = 2, accumulators = 4;
+    __m128d queryX = _mm_set1_pd(x), queryY = _mm_set1_pd(y);
+    __m128d best[accumulators], bestIndex[accumulators], index[accumulators];
+    for(int a = 0; a < accumulators; a++){
+        best[a] = _mm_set1_pd(std::numeric_limits<double>::infinity());
+        bestIndex[a] = _mm_set1_pd(-1);
+        index[a] = _mm_setr_pd(a * lanes, a * lanes + 1);
+    }
+    __m128d step = _mm_set1_pd(lanes * accumulators);
+    int i = 0;
+    for(; i + lanes * accumulators <= count; i += lanes * accumulators){
+        for(int a = 0; a < accumulators; a++){
+            __m128d dx = _mm_sub_pd(_mm_loadu_pd(xs + i + a * lanes), queryX);
+            __m128d dy = _mm_sub_pd(_mm_loadu_pd(ys + i + a * lanes), queryY);
+            __m128d distance = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+            __m128d closer = _mm_cmplt_pd(distance, best[a]); // false for NaN
+            best[a] = _mm_or_pd(_mm_and_pd(closer, distance), _mm_andnot_pd(closer, best[a]));
+            bestIndex[a] = _mm_or_pd(_mm_and_pd(closer, index[a]), _mm_andnot_pd(closer, bestIndex[a]));
+            index[a] = _mm_add_pd(index[a], step);
+        }
+    }
+    double distances[lanes * accumulators], indices[lanes * accumulators];
+    for(int a = 0; a < accumulators; a++){
+        _mm_storeu_pd(distances + a * lanes, best[a]);
+        _mm_storeu_pd(indices + a * lanes, bestIndex[a]);
+    }
+    int bestLane = -1;
+    double bestDistance = std::numeric_limits<double>::infinity();
+    ReduceLanes(distances, indices, lanes * accumulators, bestLane, bestDistance);
+    return NearestTail(xs, ys, i, count, x, y, bestLane, bestDistance);
+}
+
+__attribute__((target("avx2")))
+static int NearestAvx2(const double *xs, const double *ys, int count, double x, double y){
+    const int lanes = 4, accumulators = 4;
+    __m256d queryX = _mm256_set1_pd(x), queryY = _mm256_set1_pd(y);
+    __m256d best[accumulators], bestIndex[accumulators], index[accumulators];
+    for(int a = 0; a < accumulators; a++){
+        best[a] = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+        bestIndex[a] = _mm256_set1_pd(-1);
+        index[a] = _mm256_setr_pd(a * lanes, a * lanes + 1, a * lanes + 2, a * lanes + 3);
+    }
+    __m256d step = _mm256_set1_pd(lanes * accumulators);
+    int i = 0;
+    for(; i + lanes * accumulators <= count; i += lanes * accumulators){
+        for(int a = 0; a < accumulators; a++){
+            __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(xs + i + a * lanes), queryX);
+            __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(ys + i + a * lanes), queryY);
+            __m256d distance = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+            __m256d closer = _mm256_cmp_pd(distance, best[a], _CMP_LT_OQ); // false for NaN
+            best[a] = _mm256_blendv_pd(best[a], distance, closer);
+            bestIndex[a] = _mm256_blendv_pd(bestIndex[a], index[a], closer);
+            index[a] = _mm256_add_pd(index[a], step);
+        }
+    }
+    double distances[lanes * accumulators], indices[lanes * accumulators];
+    for(int a = 0; a < accumulators; a++){
+        _mm256_storeu_pd(distances + a * lanes, best[a]);
+        _mm256_storeu_pd(indices + a * lanes, bestIndex[a]);
+    }
+    int bestLane = -1;
+    double bestDistance = std::numeric_limits<double>::infinity();
+    ReduceLanes(distances, indices, lanes * accumulators, bestLane, bestDistance);
+    return NearestTail(xs, ys, i, count, x, y, bestLane, bestDistance);
+}
+
+__attribute__((target("avx512f")))
+static int NearestAvx512(const double *xs, const double *ys, int count, double x, double y){
+    const int lanes = 8, accumulators = 2;
+    __m512d queryX = _mm512_set1_pd(x), queryY = _mm512_set1_pd(y);
+    __m512d best[accumulators], bestIndex[accumulators], index[accumulators];
+    for(int a = 0; a < accumulators; a++){
+        best[a] = _mm512_set1_pd(std::numeric_limits<double>::infinity());
+        bestIndex[a] = _mm512_set1_pd(-1);
+        index[a] = _mm512_setr_pd(a * lanes, a * lanes + 1, a * lanes + 2, a * lanes + 3,
+                                  a * lanes + 4, a * lanes + 5, a * lanes + 6, a * lanes + 7);
+    }
+    __m512d step = _mm512_set1_pd(lanes * accumulators);
+    int i = 0;
+    for(; i + lanes * accumulators <= count; i += lanes * accumulators){
+        for(int a = 0; a < accumulators; a++){
+            __m512d dx = _mm512_sub_pd(_mm512_loadu_pd(xs + i + a * lanes), queryX);
+            __m512d dy = _mm512_sub_pd(_mm512_loadu_pd(ys + i + a * lanes), queryY);
+            __m512d distance = _mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy));
+            __mmask8 closer = _mm512_cmp_pd_mask(distance, best[a], _CMP_LT_OQ); // false for NaN
+            best[a] = _mm512_mask_blend_pd(closer, best[a], distance);
+            bestIndex[a] = _mm512_mask_blend_pd(closer, bestIndex[a], index[a]);
+            index[a] = _mm512_add_pd(index[a], step);
+        }
+    }
+    double distances[lanes * accumulators], indices[lanes * accumulators];
+    for(int a = 0; a < accumulators; a++){
+        _mm512_storeu_pd(distances + a * lanes, best[a]);
+        _mm512_storeu_pd(indices + a * lanes, bestIndex[a]);
+    }
+    int bestLane = -1;
+    double bestDistance = std::numeric_limits<double>::infinity();
+    ReduceLanes(distances, indices, lanes * accumulators, bestLane, bestDistance);
+    return NearestTail(xs, ys, i, count, x, y, bestLane, bestDistance);
+}
+
+#endif // NEARESTKERNEL_X86
+
+// Selects the widest kernel the CPU (and the operating system) supports
+static NearestFunction SelectKernel(const char **name){
+#ifdef NEARESTKERNEL_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f")){ *name = "avx512"; return NearestAvx512; }
+    if(__builtin_cpu_supports("avx2")){ *name = "avx2"; return NearestAvx2; }
+    if(__builtin_cpu_supports("sse2")){ *name = "sse2"; return NearestSse2; }
+#endif
+    *name = "scalar";
+    return NearestScalar;
+}
+
+struct NearestKernel
+{
+    const char *name;
+    NearestFunction function;
+    NearestKernel(): name(nullptr), function(SelectKernel(&name)) {}
+};
+
+// The kernel is selected once, on first use (thread-safe static initialization)
+static const NearestKernel &Kernel(){
+    static const NearestKernel kernel;
+    return kernel;
+}
+
+int NearestIndex(const double *xs, const double *ys, int count, double x, double y){
+    return Kernel().function(xs, ys, count, x, y);
+}
+
+const char *NearestKernelName(){
+    return Kernel().name;
+}
@@ -0,0 +1,13 @@
+#ifndef NEARESTKERNEL_H
+#define NEARESTKERNEL_H
+
+// Index of the point closest to (x, y) among the count points (xs[i], ys[i]), compared by squared
+// distance; ties go to the lowest index. Points with a NaN coordinate are skipped. Returns -1 if no
+// point is left. The kernel is vectorized with the widest instruction set the CPU supports
+// (AVX-512, AVX2, SSE2) and falls back to a scalar loop; all variants give the same result.
+int NearestIndex(const double *xs, const double *ys, int count, double x, double y);
+
+// Name of the kernel that NearestIndex uses on this CPU ("avx512", "avx2", "sse2" or "scalar")
+const char *NearestKernelName();
+
+#endif // NEARESTKERNEL_H
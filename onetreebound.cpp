@@ -0,0 +1,389 @@
+#include "onetreebound.h"
+#include "candidateneighbors.h"
+#include "parallelfor.h"
+
+#include <QPair>
+#include <QVarLengthArray>
+#include <algorithm>
+#include <limits>
+
+static const int leafCapacity = 8; // maximum number of points in a leaf
+static const int stallIterations = 10; // iterations without a better bound before the step size is halved
+
+OneTreeBound::OneTreeBound(const StopStore &stops, int threadCount):
+    stops(stops),
+    threadCount(threadCount),
+    iterations(0)
+{
+
+}
+
+// Runs the subgradient optimization on the candidate graph and evaluates the best penalties exactly
+double OneTreeBound::Compute(const QVector<int> &tourStops, double upperBound, const ImprovementBudget &budget, int neighborCount){
+    iterations = 0;
+    int count = tourStops.count() + 1;
+    x.resize(count); y.resize(count);
+    x[0] = stops.x.at(0); y[0] = stops.y.at(0);
+    for(int i = 1; i < count; i++){
+        x[i] = stops.x.at(tourStops.at(i - 1));
+        y[i] = stops.y.at(tourStops.at(i - 1));
+    }
+    penalty.fill(0, count);
+    // One or two stops have a single tour
+    if(count <= 3)
+        return count == 1 ? 0 : Cost(0, 1) + (count == 2 ? Cost(0, 1) : Cost(1, 2) + Cost(2, 0));
+
+    slotPoint.resize(count - 1);
+    for(int i = 1; i < count; i++)
+        slotPoint[i - 1] = i;
+    nodes.clear();
+    nodes.reserve(2 * (count / leafCapacity + 1));
+    BuildNode(0, count - 1);
+
+    // Candidate graph: the nearest neighbors of every point and the Euclidean minimum spanning tree,
+    // which keeps the graph connected
+    QVector<int> points;
+    for(int i = 1; i < count; i++)
+        points.append(i);
+    CandidateNeighbors candidates;
+    candidates.BuildNearest(x, y, points, neighborCount, threadCount);
+    QVector<int> edges;
+    for(int i = 1; i < count; i++){
+        for(const int *neighbor = candidates.Begin(i); neighbor != candidates.End(i); ++neighbor)
+            edges << i << *neighbor;
+    }
+    BuildAdjacency(edges);
+    ExactTree(&edges);
+    BuildAdjacency(edges);
+
+    // Subgradient optimization: the penalty of a stop with more than two edges grows, the penalty of a
+    // leaf shrinks. The step size follows the distance to the known tour and is halved when it stalls.
+    BudgetTracker tracker(budget);
+    QVector<int> degree(count);
+    QVector<double> bestPenalty = penalty;
+    double bestValue = -std::numeric_limits<double>::infinity();
+    double scale = 2;
+    int stalled = 0;
+    while(!tracker.Exhausted()){
+        degree.fill(0);
+        double value = SparseTree(degree) + DepotEdges(&degree) - 2 * PenaltySum();
+        tracker.CountIterations();
+        if(value > bestValue){
+            bestValue = value;
+            bestPenalty = penalty;
+            stalled = 0;
+        }else if(++stalled >= stallIterations){
+            scale /= 2;
+            stalled = 0;
+        }
+
+        double norm = 0;
+        for(int i = 0; i < count; i++)
+            norm += (degree.at(i) - 2) * (degree.at(i) - 2);
+        // Every stop has two edges: the 1-tree is a tour and the bound cannot be improved
+        if(norm == 0 || scale < 1e-6 || value >= upperBound)
+            break;
+        double step = scale * (upperBound - value) / norm;
+        for(int i = 0; i < count; i++)
+            penalty[i] += step * (degree.at(i) - 2);
+    }
+    iterations = tracker.Iterations();
+
+    // The sparse tree can be longer than the exact one, so the bound comes from the exact tree
+    penalty = bestPenalty;
+    for(int i = nodes.count() - 1; i >= 0; i--){
+        Node &node = nodes[i];
+        if(node.left < 0){
+            node.minPenalty = std::numeric_limits<double>::infinity();
+            for(int slot = node.begin; slot < node.end; slot++)
+                node.minPenalty = std::min(node.minPenalty, penalty.at(slotPoint.at(slot)));
+        }else{
+            node.minPenalty = std::min(nodes.at(node.left).minPenalty, nodes.at(node.right).minPenalty);
+        }
+    }
+    return ExactTree(nullptr) + DepotEdges(nullptr) - 2 * PenaltySum();
+}
+
+// Builds the symmetric candidate graph from a list of point pairs (duplicates are dropped)
+void OneTreeBound::BuildAdjacency(const QVector<int> &edges){
+    int count = x.count();
+    QVector<QPair<int, int>> pairs;
+    pairs.reserve(edges.count());
+    for(int i = 0; i < edges.count(); i += 2){
+        pairs.append(qMakePair(edges.at(i), edges.at(i + 1)));
+        pairs.append(qMakePair(edges.at(i + 1), edges.at(i)));
+    }
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+    adjacencyOffsets.fill(0, count + 1);
+    adjacency.resize(pairs.count());
+    for(int i = 0; i < pairs.count(); i++){
+        adjacency[i] = pairs.at(i).second;
+        adjacencyOffsets[pairs.at(i).first + 1]++;
+    }
+    for(int i = 0; i < count; i++)
+        adjacencyOffsets[i + 1] += adjacencyOffsets.at(i);
+}
+
+// Builds the subtree over slotPoint[begin, end) (split at the median of the wider side) and returns its node
+int OneTreeBound::BuildNode(int begin, int end){
+    Node node;
+    node.minX = node.maxX = x.at(slotPoint.at(begin));
+    node.minY = node.maxY = y.at(slotPoint.at(begin));
+    for(int i = begin + 1; i < end; i++){
+        node.minX = std::min(node.minX, x.at(slotPoint.at(i))); node.maxX = std::max(node.maxX, x.at(slotPoint.at(i)));
+        node.minY = std::min(node.minY, y.at(slotPoint.at(i))); node.maxY = std::max(node.maxY, y.at(slotPoint.at(i)));
+    }
+    node.minPenalty = 0;
+    node.left = -1; node.right = -1;
+    node.begin = begin; node.end = end;
+    node.component = -1;
+
+    int index = nodes.count();
+    nodes.append(node);
+    if(end - begin <= leafCapacity)
+        return index;
+
+    int middle = begin + (end - begin) / 2;
+    const QVector<double> &coordinate = (node.maxX - node.minX >= node.maxY - node.minY) ? x : y;
+    std::nth_element(slotPoint.begin() + begin, slotPoint.begin() + middle, slotPoint.begin() + end,
+                     [&coordinate](int a, int b){ return coordinate.at(a) < coordinate.at(b); });
+    int left = BuildNode(begin, middle);
+    int right = BuildNode(middle, end);
+    nodes[index].left = left;
+    nodes[index].right = right;
+    return index;
+}
+
+// Squared distance between the point (x, y) and a bounding box (0 if inside)
+static inline double BoxDistance(double minX, double minY, double maxX, double maxY, double x, double y){
+    double dx = x < minX ? minX - x : (x > maxX ? x - maxX : 0);
+    double dy = y < minY ? minY - y : (y > maxY ? y - maxY : 0);
+    return dx * dx + dy * dy;
+}
+
+// Boruvka: every round, each component is joined with the component behind its cheapest outgoing edge.
+// The cheapest edge of every point is searched in parallel with the k-d tree. Ties go to the lowest point.
+double OneTreeBound::ExactTree(QVector<int> *edges){
+    int count = x.count();
+    QVector<int> parent(count);
+    for(int i = 0; i < count; i++)
+        parent[i] = i;
+    auto find = [&parent](int i){
+        while(parent.at(i) != i){
+            parent[i] = parent.at(parent.at(i));
+            i = parent.at(i);
+        }
+        return i;
+    };
+
+    QVector<int> component(count, 0);
+    QVector<int> target(count);
+    QVector<double> targetCost(count);
+    QVector<int> cheapest(count);
+    QVector<double> limit(count);
+    double cost = 0;
+    for(int components = count - 1; components > 1; ){
+        for(int i = 1; i < count; i++)
+            component[i] = find(i);
+        for(int i = nodes.count() - 1; i >= 0; i--){
+            Node &node = nodes[i];
+            if(node.left < 0){
+                node.component = component.at(slotPoint.at(node.begin));
+                for(int slot = node.begin + 1; slot < node.end; slot++){
+                    if(component.at(slotPoint.at(slot)) != node.component)
+                        node.component = -1;
+                }
+            }else{
+                int left = nodes.at(node.left).component;
+                node.component = left == nodes.at(node.right).component ? left : -1;
+            }
+        }
+
+        // The candidate graph usually holds the cheapest edge already: the cheapest candidate edge of a
+        // component limits the search of all its points
+        ParallelFor(count - 1, threadCount, [&](int begin, int end, int){
+            for(int q = begin + 1; q < end + 1; q++){
+                target[q] = -1;
+                targetCost[q] = std::numeric_limits<double>::infinity();
+                for(int i = adjacencyOffsets.at(q); i < adjacencyOffsets.at(q + 1); i++){
+                    int j = adjacency.at(i);
+                    double edge = Cost(q, j);
+                    if(component.at(j) != component.at(q) && (edge < targetCost.at(q) || (edge == targetCost.at(q) && j < target.at(q)))){
+                        targetCost[q] = edge;
+                        target[q] = j;
+                    }
+                }
+            }
+        });
+        limit.fill(std::numeric_limits<double>::infinity());
+        for(int q = 1; q < count; q++)
+            limit[component.at(q)] = std::min(limit.at(component.at(q)), targetCost.at(q));
+
+        // Subtrees whose points all belong to the point's own component or that cannot hold a cheaper edge are skipped
+        ParallelFor(count - 1, threadCount, [&](int begin, int end, int){
+            QVarLengthArray<int, 128> stack;
+            for(int q = begin + 1; q < end + 1; q++){
+                int own = component.at(q);
+                int best = target.at(q);
+                double bestCost = targetCost.at(q);
+                stack.clear();
+                stack.append(0);
+                while(!stack.isEmpty()){
+                    const Node &node = nodes.at(stack.last());
+                    stack.removeLast();
+                    if(node.component == own)
+                        continue;
+                    // Skipped if the box is farther than the cheapest edge, less the smallest penalties
+                    double reach = std::min(bestCost, limit.at(own)) - node.minPenalty - penalty.at(q);
+                    if(reach < 0 || BoxDistance(node.minX, node.minY, node.maxX, node.maxY, x.at(q), y.at(q)) > reach * reach)
+                        continue;
+                    if(node.left < 0){
+                        for(int slot = node.begin; slot < node.end; slot++){
+                            int j = slotPoint.at(slot);
+                            if(component.at(j) == own)
+                                continue;
+                            double edge = Cost(q, j);
+                            if(edge < bestCost || (edge == bestCost && j < best)){
+                                bestCost = edge;
+                                best = j;
+                            }
+                        }
+                        continue;
+                    }
+                    const Node &left = nodes.at(node.left);
+                    const Node &right = nodes.at(node.right);
+                    if(BoxDistance(left.minX, left.minY, left.maxX, left.maxY, x.at(q), y.at(q)) <=
+                       BoxDistance(right.minX, right.minY, right.maxX, right.maxY, x.at(q), y.at(q))){
+                        stack.append(node.right); stack.append(node.left);
+                    }else{
+                        stack.append(node.left); stack.append(node.right);
+                    }
+                }
+                target[q] = best;
+                targetCost[q] = bestCost;
+            }
+        });
+
+        // Cheapest edge of every component (lowest point on ties), then join along these edges
+        cheapest.fill(-1);
+        for(int q = 1; q < count; q++){
+            int &current = cheapest[component.at(q)];
+            if(target.at(q) >= 0 && (current < 0 || targetCost.at(q) < targetCost.at(current)))
+                current = q;
+        }
+        for(int c = 1; c < count; c++){
+            int q = cheapest.at(c);
+            if(q < 0)
+                continue;
+            int a = find(q), b = find(target.at(q));
+            if(a == b)
+                continue;
+            parent[a] = b;
+            cost += targetCost.at(q);
+            if(edges)
+                *edges << q << target.at(q);
+            components--;
+        }
+    }
+    return cost;
+}
+
+// Prim's algorithm on the candidate graph, starting at the first point. The heap holds every point outside
+// the tree at most once, keyed by its cheapest edge to the tree.
+double OneTreeBound::SparseTree(QVector<int> &degree) const{
+    int count = x.count();
+    QVector<double> key(count, std::numeric_limits<double>::infinity());
+    QVector<int> link(count, -1); // tree end of the cheapest edge
+    QVector<int> heapPosition(count, -1); // position in the heap (-1: not reached yet, -2: in the tree)
+    QVector<int> heap;
+    heap.reserve(count);
+    auto place = [&](int position, int point){
+        heap[position] = point;
+        heapPosition[point] = position;
+    };
+    auto siftUp = [&](int position){
+        int point = heap.at(position);
+        while(position > 0 && key.at(heap.at((position - 1) / 2)) > key.at(point)){
+            place(position, heap.at((position - 1) / 2));
+            position = (position - 1) / 2;
+        }
+        place(position, point);
+    };
+    auto siftDown = [&](int position){
+        int point = heap.at(position);
+        for(int child = 2 * position + 1; child < heap.count(); child = 2 * position + 1){
+            if(child + 1 < heap.count() && key.at(heap.at(child + 1)) < key.at(heap.at(child)))
+                child++;
+            if(key.at(heap.at(child)) >= key.at(point))
+                break;
+            place(position, heap.at(child));
+            position = child;
+        }
+        place(position, point);
+    };
+
+    double cost = 0;
+    key[1] = 0;
+    heap.append(1);
+    heapPosition[1] = 0;
+    while(!heap.isEmpty()){
+        int point = heap.at(0);
+        heapPosition[point] = -2;
+        int last = heap.last();
+        heap.removeLast();
+        if(!heap.isEmpty() && last != point){
+            heap[0] = last;
+            siftDown(0);
+        }
+        if(link.at(point) >= 0){
+            cost += key.at(point);
+            degree[point]++;
+            degree[link.at(point)]++;
+        }
+        for(int i = adjacencyOffsets.at(point); i < adjacencyOffsets.at(point + 1); i++){
+            int neighbor = adjacency.at(i);
+            if(heapPosition.at(neighbor) == -2)
+                continue;
+            double edge = Cost(point, neighbor);
+            if(edge >= key.at(neighbor))
+                continue;
+            key[neighbor] = edge;
+            link[neighbor] = point;
+            if(heapPosition.at(neighbor) < 0){
+                heap.append(neighbor);
+                heapPosition[neighbor] = heap.count() - 1;
+            }
+            siftUp(heapPosition.at(neighbor));
+        }
+    }
+    return cost;
+}
+
+// The two cheapest edges between the depot and the other points
+double OneTreeBound::DepotEdges(QVector<int> *degree) const{
+    int first = -1, second = -1;
+    for(int i = 1; i < x.count(); i++){
+        double edge = Cost(0, i);
+        if(first < 0 || edge < Cost(0, first)){
+            second = first;
+            first = i;
+        }else if(second < 0 || edge < Cost(0, second)){
+            second = i;
+        }
+    }
+    if(degree){
+        (*degree)[0] += 2;
+        (*degree)[first]++;
+        (*degree)[second]++;
+    }
+    return Cost(0, first) + Cost(0, second);
+}
+
+// Sum of the penalties of all points
+double OneTreeBound::PenaltySum() const{
+    double sum = 0;
+    for(double value : penalty)
+        sum += value;
+    return sum;
+}
@@ -0,0 +1,51 @@
+#ifndef ONETREEBOUND_H
+#define ONETREEBOUND_H
+
+#include <QVector>
+#include <math.h>
+#include "stopstore.h"
+#include "improvementbudget.h"
+
+// Held-Karp lower bound of the shortest closed tour through a set of stops. A 1-tree is a spanning tree
+// over all stops but the depot plus the two shortest depot edges, so every tour is a 1-tree. A penalty
+// pi[i] on every edge at stop i adds 2 * sum(pi) to every tour, which makes 1-tree(pi) - 2 * sum(pi) a
+// lower bound for any penalties; subgradient optimization moves them towards a 1-tree in which every stop
+// has two edges. The iterations use the spanning tree of a sparse candidate graph (nearest neighbors plus
+// the Euclidean minimum spanning tree). The returned bound is evaluated once more with the exact minimum
+// spanning tree over all pairs (Boruvka with a k-d tree), so it holds for every tour.
+class OneTreeBound
+{
+public:
+    OneTreeBound(const StopStore &stops, int threadCount = 0);
+    // Lower bound of the closed tours through the depot and the given stops. upperBound is the length of
+    // a known tour; the subgradient iterations are counted against the budget.
+    double Compute(const QVector<int> &tourStops, double upperBound, const ImprovementBudget &budget, int neighborCount = 8);
+    int Iterations() const { return iterations; } // number of subgradient iterations of the last run
+private:
+    struct Node {
+        double minX, minY, maxX, maxY; // bounding box of the points below this node
+        double minPenalty; // smallest penalty below this node
+        int left, right; // child nodes (-1 for leaves)
+        int begin, end; // slots of the points below this node
+        int component; // component of all points below this node (-1 if they are in different components)
+    };
+    const StopStore &stops;
+    int threadCount;
+    int iterations;
+    QVector<double> x, y; // coordinates of the run, index 0 is the depot
+    QVector<double> penalty; // pi of every point
+    QVector<int> adjacencyOffsets, adjacency; // candidate graph without the depot: neighbors of i are adjacency[offsets[i], offsets[i+1])
+    QVector<Node> nodes; // k-d tree over the points without the depot, the root is at index 0
+    QVector<int> slotPoint; // points stored node by node
+    double Cost(int a, int b) const { // penalized length of the edge (a, b)
+        return sqrt((x[a]-x[b])*(x[a]-x[b]) + (y[a]-y[b])*(y[a]-y[b])) + penalty[a] + penalty[b];
+    }
+    void BuildAdjacency(const QVector<int> &edges); // builds the candidate graph from point pairs
+    int BuildNode(int begin, int end); // builds the subtree over slotPoint[begin, end) and returns its node
+    double ExactTree(QVector<int> *edges); // minimum spanning tree over all pairs (edges as point pairs), returns its cost
+    double SparseTree(QVector<int> &degree) const; // minimum spanning tree of the candidate graph, returns its cost
+    double DepotEdges(QVector<int> *degree) const; // two cheapest depot edges, returns their cost
+    double PenaltySum() const; // sum of all penalties
+};
+
+#endif // ONETREEBOUND_H
@@ -0,0 +1,153 @@
+#include "oropt.h"
+
+static const double minimumGain = 1e-10; // smaller gains are treated as rounding noise
+static const int maxChainLength = 3; // longest chain of consecutive stops that is moved
+
+OrOpt::OrOpt(const DistanceFunction &distance, const CandidateNeighbors &candidates, const ImprovementBudget &budget):
+    distance(distance),
+    candidates(candidates),
+    budget(budget),
+    stream(nullptr),
+    scratch(nullptr),
+    iterations(0),
+    queueHead(0),
+    queueSize(0)
+{
+
+}
+
+// Runs Or-opt until no improving move is left or the budget is used up and returns the route length
+double OrOpt::Optimize(QVector<int> &route){
+    iterations = 0;
+    if(route.count() < maxChainLength + 3)
+        return distance.RouteLength(route);
+
+    BudgetTracker tracker(budget);
+    tour.swap(route);
+    if(scratch)
+        scratch->Swap(position, queue, queued);
+    position.fill(-1, distance.Count());
+    for(int i = 0; i < tour.count(); i++)
+        position[tour.at(i)] = i;
+
+    queue.fill(0, tour.count());
+    queued.fill(false, distance.Count());
+    queueHead = 0; queueSize = 0;
+    for(int stop : tour)
+        Push(stop);
+
+    while(queueSize > 0 && !tracker.Exhausted()){
+        int a = queue.at(queueHead);
+        queueHead = (queueHead + 1) % queue.count();
+        queueSize--;
+        queued[a] = false;
+        if(ImproveStop(a)){
+            tracker.CountIterations();
+            Push(a);
+            if(stream && stream->Due())
+                stream->Publish(tour, distance.RouteLength(tour));
+        }
+    }
+    iterations = tracker.Iterations();
+
+    if(scratch)
+        scratch->Swap(position, queue, queued);
+    route.swap(tour);
+    return distance.RouteLength(route);
+}
+
+// Tries the chains that start or end at stop a
+bool OrOpt::ImproveStop(int a){
+    int index = position.at(a);
+    for(int length = 1; length <= maxChainLength; length++){
+        if(ImproveChain(index, length))
+            return true;
+        if(length > 1 && ImproveChain(index - length + 1, length))
+            return true;
+    }
+    return false;
+}
+
+// Tries to move the chain tour[first .. first + length - 1] between two stops u, v = Next(u)
+// where u or v is a candidate neighbor of a chain end
+bool OrOpt::ImproveChain(int first, int length){
+    int count = tour.count();
+    first = (first % count + count) % count;
+    int s1 = At(first), s2 = At(first + length - 1);
+    int p = At(first - 1), n = At(first + length);
+
+    // Gain of taking the chain out and closing the gap with the edge (p, n)
+    double removeGain = distance(p, s1) + distance(s2, n) - distance(p, n);
+    if(removeGain <= minimumGain)
+        return false;
+
+    for(int end = 0; end < 2; end++){
+        int chainEnd = end == 0 ? s1 : s2;
+        for(const int *candidate = candidates.Begin(chainEnd); candidate != candidates.End(chainEnd); ++candidate){
+            int c = *candidate;
+            // The new edge to c alone has to be shorter than what removing the chain gains
+            if(distance(chainEnd, c) >= removeGain)
+                break;
+            // Both edges at c are possible insertion places
+            for(int side = 0; side < 2; side++){
+                int u = side == 0 ? c : Prev(c);
+                int v = side == 0 ? Next(c) : c;
+                // The insertion edge must not touch the chain
+                if((position.at(u) - first + count) % count < length || (position.at(v) - first + count) % count < length)
+                    continue;
+                double distanceUV = distance(u, v);
+                double forwardCost = distance(u, s1) + distance(s2, v) - distanceUV;
+                double reversedCost = distance(u, s2) + distance(s1, v) - distanceUV;
+                bool reversed = reversedCost < forwardCost;
+                if((reversed ? reversedCost : forwardCost) - removeGain < -minimumGain){
+                    MoveChain(first, length, u, reversed);
+                    Push(p); Push(n); Push(s1); Push(s2); Push(u); Push(v);
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+// Moves the chain tour[first .. first + length - 1] between u and Next(u). Only the stops between
+// the chain and the insertion place on the shorter side of the cycle are shifted.
+void OrOpt::MoveChain(int first, int length, int u, bool reversed){
+    int count = tour.count();
+    int chainEnd = (first + length - 1) % count;
+    int forwardSpan = (position.at(u) - chainEnd + count) % count; // stops from n up to u
+    int backwardSpan = count - length - forwardSpan; // stops from Next(u) up to p
+
+    buffer.clear();
+    int start;
+    if(forwardSpan <= backwardSpan){
+        // p [chain] n .. u v  ->  p n .. u [chain] v
+        start = first;
+        for(int k = 1; k <= forwardSpan; k++)
+            buffer.append(At(chainEnd + k));
+    }else{
+        // u v .. p [chain] n  ->  u [chain] v .. p n
+        start = (position.at(u) + 1) % count;
+    }
+    for(int k = 0; k < length; k++)
+        buffer.append(At(reversed ? chainEnd - k : first + k));
+    if(forwardSpan > backwardSpan){
+        for(int k = 0; k < backwardSpan; k++)
+            buffer.append(At(start + k));
+    }
+
+    for(int k = 0; k < buffer.count(); k++){
+        int index = (start + k) % count;
+        tour[index] = buffer.at(k);
+        position[buffer.at(k)] = index;
+    }
+}
+
+// Clears the don't-look bit of a stop so that it is looked at again
+void OrOpt::Push(int stop){
+    if(queued.at(stop))
+        return;
+    queued[stop] = true;
+    queue[(queueHead + queueSize) % queue.count()] = stop;
+    queueSize++;
+}
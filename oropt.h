@@ -0,0 +1,44 @@
+#ifndef OROPT_H
+#define OROPT_H
+
+#include <QVector>
+#include "distancefunction.h"
+#include "candidateneighbors.h"
+#include "improvementbudget.h"
+#include "routestream.h"
+#include "improvementscratch.h"
+
+// Or-opt local search on a closed route: chains of 1 to 3 consecutive stops are moved,
+// possibly reversed, between two other stops next to a candidate neighbor of a chain end.
+// Every move is evaluated in O(1) from the coordinates of the stops around it.
+class OrOpt
+{
+public:
+    OrOpt(const DistanceFunction &distance, const CandidateNeighbors &candidates, const ImprovementBudget &budget);
+    double Optimize(QVector<int> &route); // improves the closed route in place and returns its length
+    int Iterations() const { return iterations; } // number of moves applied by the last run
+    void SetStream(RouteStream *stream) { this->stream = stream; } // publishes the improving route (nullptr: never)
+    void SetScratch(ImprovementScratch *scratch) { this->scratch = scratch; } // borrows the work arrays from the scratch (nullptr: own arrays)
+private:
+    const DistanceFunction &distance;
+    const CandidateNeighbors &candidates;
+    ImprovementBudget budget;
+    RouteStream *stream; // receives the best route so far (nullptr: none)
+    ImprovementScratch *scratch; // lends the work arrays of a run (nullptr: the stage's own)
+    int iterations;
+    QVector<int> tour; // route that is improved
+    QVector<int> position; // position of every stop in the tour
+    QVector<int> queue; // ring buffer of the stops whose don't-look bit is off
+    QVector<bool> queued; // don't-look bit cleared (stop is in the queue)
+    int queueHead, queueSize;
+    QVector<int> buffer; // scratch space for moving a chain
+    int At(int index) const { return tour.at((index % tour.count() + tour.count()) % tour.count()); }
+    int Next(int stop) const { return At(position.at(stop) + 1); }
+    int Prev(int stop) const { return At(position.at(stop) - 1); }
+    bool ImproveStop(int a); // applies the first improving chain move with a at one end of the chain
+    bool ImproveChain(int first, int length); // tries to move the chain starting at the given position
+    void MoveChain(int first, int length, int u, bool reversed); // moves a chain between u and its successor
+    void Push(int stop); // clears the don't-look bit of a stop
+};
+
+#endif // OROPT_H
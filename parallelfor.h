@@ -0,0 +1,51 @@
+#ifndef PARALLELFOR_H
+#define PARALLELFOR_H
+
+#include <QThread>
+#include <functional>
+#include <thread>
+#include <vector>
+#include "taskscheduler.h"
+
+// Number of chunks a parallel stage with the given thread count uses: threadCount, or with threadCount <= 0
+// the threads of the current pool (one per core without a pool)
+inline int ParallelThreadCount(int threadCount){
+    if(threadCount > 0)
+        return threadCount;
+    TaskScheduler *scheduler = TaskScheduler::Current();
+    return scheduler ? scheduler->ThreadCount() : QThread::idealThreadCount();
+}
+
+// Splits the items [0, count) into one contiguous chunk per thread and calls body(begin, end, worker)
+// for every chunk. The chunks only depend on count and threadCount, so results that are combined
+// in item order do not depend on the scheduling. threadCount <= 0 uses one chunk per thread of the pool.
+// Inside a TaskScheduler (see TaskScheduler::Scope) the chunks run on its threads, so nested loops
+// do not start more threads than the pool has; without one every chunk gets a thread of its own.
+// worker is the number of the chunk.
+inline void ParallelFor(int count, int threadCount, const std::function<void(int begin, int end, int worker)> &body){
+    threadCount = ParallelThreadCount(threadCount);
+    if(TaskScheduler *scheduler = TaskScheduler::Current()){
+        scheduler->ParallelFor(count, threadCount, body);
+        return;
+    }
+    if(threadCount > count)
+        threadCount = count;
+    if(threadCount <= 1){
+        if(count > 0)
+            body(0, count, 0);
+        return;
+    }
+
+    // The calling thread works on the first chunk
+    std::vector<std::thread> threads;
+    for(int worker = 1; worker < threadCount; worker++){
+        int begin = (int)((long long)count * worker / threadCount);
+        int end = (int)((long long)count * (worker + 1) / threadCount);
+        threads.emplace_back(body, begin, end, worker);
+    }
+    body(0, (int)((long long)count / threadCount), 0);
+    for(auto &thread : threads)
+        thread.join();
+}
+
+#endif // PARALLELFOR_H
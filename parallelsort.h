@@ -0,0 +1,47 @@
+#ifndef PARALLELSORT_H
+#define PARALLELSORT_H
+
+#include <QVector>
+#include <algorithm>
+#include "parallelfor.h"
+
+// Sorts items with operator<: every thread sorts one contiguous chunk, then neighboring sorted runs are
+// merged pairwise in parallel until one run is left. The chunks only depend on the item count and
+// threadCount, and equal items keep the order std::merge gives them, so the result does not depend on
+// the scheduling. threadCount <= 0 uses one thread per core.
+template<class T>
+void ParallelSort(QVector<T> &items, int threadCount){
+    int count = items.count();
+    int chunks = ParallelThreadCount(threadCount);
+    chunks = std::max(1, std::min(chunks, count));
+    QVector<int> bound(chunks + 1);
+    for(int i = 0; i <= chunks; i++)
+        bound[i] = (int)((long long)count * i / chunks);
+
+    T *data = items.data(); // detach once, before the threads write to it
+    ParallelFor(chunks, chunks, [&](int begin, int end, int){
+        for(int chunk = begin; chunk < end; chunk++)
+            std::sort(data + bound.at(chunk), data + bound.at(chunk + 1));
+    });
+    if(chunks == 1)
+        return;
+
+    // Merge runs of width chunks into runs of twice the width
+    QVector<T> merged(count);
+    for(int width = 1; width < chunks; width *= 2){
+        const T *source = items.constData();
+        T *target = merged.data();
+        int pairs = (chunks + 2 * width - 1) / (2 * width);
+        ParallelFor(pairs, chunks, [&](int begin, int end, int){
+            for(int pair = begin; pair < end; pair++){
+                int first = bound.at(2 * pair * width);
+                int middle = bound.at(std::min(chunks, (2 * pair + 1) * width));
+                int last = bound.at(std::min(chunks, (2 * pair + 2) * width));
+                std::merge(source + first, source + middle, source + middle, source + last, target + first);
+            }
+        });
+        items.swap(merged);
+    }
+}
+
+#endif // PARALLELSORT_H
@@ -0,0 +1,197 @@
+#include "pickupdeliverysearch.h"
+
+static const double minimumGain = 1e-10; // smaller gains are treated as rounding noise
+
+PickupDeliverySearch::PickupDeliverySearch(const DistanceFunction &distance, const CandidateNeighbors &candidates,
+                                           const StopStore &stops, const ImprovementBudget &budget):
+    distance(distance),
+    candidates(candidates),
+    stops(stops),
+    budget(budget),
+    iterations(0),
+    queueHead(0),
+    queueSize(0)
+{
+
+}
+
+// Runs the search until no improving move is left or the budget is used up and returns the route length
+double PickupDeliverySearch::Optimize(QVector<int> &route){
+    iterations = 0;
+    if(route.count() < 4)
+        return distance.RouteLength(route);
+
+    BudgetTracker tracker(budget);
+    tour.swap(route);
+    position.fill(-1, distance.Count());
+    for(int i = 0; i < tour.count(); i++)
+        position[tour.at(i)] = i;
+
+    queue.fill(0, tour.count());
+    queued.fill(false, distance.Count());
+    queueHead = 0; queueSize = 0;
+    for(int i = 1; i < tour.count(); i++)
+        Push(tour.at(i));
+
+    while(queueSize > 0 && !tracker.Exhausted()){
+        int stop = queue.at(queueHead);
+        queueHead = (queueHead + 1) % queue.count();
+        queueSize--;
+        queued[stop] = false;
+        if(ImproveStop(stop)){
+            tracker.CountIterations();
+            Push(stop);
+        }
+    }
+    iterations = tracker.Iterations();
+
+    route.swap(tour);
+    return distance.RouteLength(route);
+}
+
+// True if the pickup of every request in the route comes before its delivery
+bool PickupDeliverySearch::PrecedenceKept(const QVector<int> &route, const StopStore &stops){
+    QVector<bool> visited(stops.Count(), false);
+    for(int stop : route){
+        if(stops.kind.at(stop) == requestDeliveryStop && !visited.at(stops.partner.at(stop)))
+            return false;
+        visited[stop] = true;
+    }
+    return true;
+}
+
+// Successor of stop in the tour without the stops a and b
+int PickupDeliverySearch::NextSkipping(int stop, int a, int b) const{
+    int next = Next(stop);
+    while(next == a || next == b)
+        next = Next(next);
+    return next;
+}
+
+// A pickup has to stay in front of its delivery and a delivery behind its pickup
+bool PickupDeliverySearch::CanFollow(int stop, int u) const{
+    if(stops.kind.at(stop) == requestPickupStop)
+        return position.at(u) < position.at(stops.partner.at(stop));
+    if(stops.kind.at(stop) == requestDeliveryStop)
+        return position.at(u) >= position.at(stops.partner.at(stop));
+    return true;
+}
+
+// Tries to move the stop on its own, then its whole request
+bool PickupDeliverySearch::ImproveStop(int stop){
+    if(RelocateStop(stop))
+        return true;
+    if(stops.kind.at(stop) == requestPickupStop)
+        return RelocatePair(stop);
+    if(stops.kind.at(stop) == requestDeliveryStop)
+        return RelocatePair(stops.partner.at(stop));
+    return false;
+}
+
+// Moves the stop between a candidate neighbor c and the successor or the predecessor of c
+bool PickupDeliverySearch::RelocateStop(int stop){
+    int prev = Prev(stop), next = Next(stop);
+    double removeGain = distance(prev, stop) + distance(stop, next) - distance(prev, next);
+    for(const int *candidate = candidates.Begin(stop); candidate != candidates.End(stop); ++candidate){
+        int c = *candidate;
+        // Candidates are sorted, so no later one can be inserted cheaper than the removal gains
+        if(distance(stop, c) >= removeGain)
+            break;
+        // Behind c, then in front of c (behind its predecessor)
+        for(int side = 0; side < 2; side++){
+            if(side == 1 && c == 0)
+                break;
+            int u = side == 0 ? c : Prev(c);
+            if(u == stop || u == prev)
+                continue;
+            int v = NextSkipping(u, stop, -1);
+            double insertCost = distance(u, stop) + distance(stop, v) - distance(u, v);
+            if(removeGain - insertCost > minimumGain && CanFollow(stop, u)){
+                Push(prev); Push(next); Push(u); Push(v);
+                Move(stop, u);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Moves pickup and delivery of a request behind the candidate neighbors u (pickup) and w (delivery).
+// u has to come before w in the tour; if u == w both stops are placed behind u, pickup first.
+bool PickupDeliverySearch::RelocatePair(int pickup){
+    int delivery = stops.partner.at(pickup);
+    int pickupPrev = Prev(pickup), deliveryPrev = Prev(delivery);
+    double removeGain;
+    if(Next(pickup) == delivery){
+        int next = Next(delivery);
+        removeGain = distance(pickupPrev, pickup) + distance(pickup, delivery) + distance(delivery, next) - distance(pickupPrev, next);
+    }else{
+        removeGain = distance(pickupPrev, pickup) + distance(pickup, Next(pickup)) - distance(pickupPrev, Next(pickup))
+                   + distance(deliveryPrev, delivery) + distance(delivery, Next(delivery)) - distance(deliveryPrev, Next(delivery));
+    }
+
+    for(const int *candidateU = candidates.Begin(pickup); candidateU != candidates.End(pickup); ++candidateU){
+        int u = *candidateU;
+        if(distance(pickup, u) >= removeGain)
+            break;
+        if(u == delivery)
+            continue;
+        int uNext = NextSkipping(u, pickup, delivery);
+
+        // Both stops directly behind u
+        double together = distance(u, pickup) + distance(pickup, delivery) + distance(delivery, uNext) - distance(u, uNext);
+        if(removeGain - together > minimumGain){
+            Push(pickupPrev); Push(deliveryPrev); Push(u); Push(uNext);
+            Move(pickup, u);
+            Move(delivery, pickup);
+            return true;
+        }
+
+        // The delivery behind a candidate neighbor w further down the tour
+        double pickupCost = distance(u, pickup) + distance(pickup, uNext) - distance(u, uNext);
+        for(const int *candidateW = candidates.Begin(delivery); candidateW != candidates.End(delivery); ++candidateW){
+            int w = *candidateW;
+            if(pickupCost + distance(w, delivery) >= removeGain)
+                break;
+            if(w == pickup || w == u || position.at(w) < position.at(u))
+                continue;
+            int wNext = NextSkipping(w, pickup, delivery);
+            double deliveryCost = distance(w, delivery) + distance(delivery, wNext) - distance(w, wNext);
+            if(removeGain - pickupCost - deliveryCost > minimumGain){
+                Push(pickupPrev); Push(deliveryPrev); Push(u); Push(w);
+                Move(pickup, u);
+                Move(delivery, w);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Moves stop directly behind u; only the stops in between change their positions
+void PickupDeliverySearch::Move(int stop, int u){
+    int from = position.at(stop);
+    int to = position.at(u) < from ? position.at(u) + 1 : position.at(u);
+    if(from < to){
+        for(int i = from; i < to; i++){
+            tour[i] = tour.at(i + 1);
+            position[tour.at(i)] = i;
+        }
+    }else{
+        for(int i = from; i > to; i--){
+            tour[i] = tour.at(i - 1);
+            position[tour.at(i)] = i;
+        }
+    }
+    tour[to] = stop;
+    position[stop] = to;
+}
+
+// Clears the don't-look bit of a stop (the depot is never moved)
+void PickupDeliverySearch::Push(int stop){
+    if(stop == 0 || queued.at(stop))
+        return;
+    queued[stop] = true;
+    queue[(queueHead + queueSize) % queue.count()] = stop;
+    queueSize++;
+}
@@ -0,0 +1,44 @@
+#ifndef PICKUPDELIVERYSEARCH_H
+#define PICKUPDELIVERYSEARCH_H
+
+#include <QVector>
+#include "distancefunction.h"
+#include "candidateneighbors.h"
+#include "improvementbudget.h"
+#include "stopstore.h"
+
+// Local search on a closed route with paired requests: the pickup of a request has to come before its
+// delivery. Single stops and whole request pairs are moved next to candidate neighbors. The route
+// starts at the depot, which never moves, so the precedence of a move is checked in O(1) by comparing
+// the positions of the stops in the route.
+class PickupDeliverySearch
+{
+public:
+    PickupDeliverySearch(const DistanceFunction &distance, const CandidateNeighbors &candidates, const StopStore &stops,
+                         const ImprovementBudget &budget);
+    double Optimize(QVector<int> &route); // improves the route (depot first) in place and returns its length
+    int Iterations() const { return iterations; } // number of moves applied by the last run
+    static bool PrecedenceKept(const QVector<int> &route, const StopStore &stops); // true if every pickup comes before its delivery
+private:
+    const DistanceFunction &distance;
+    const CandidateNeighbors &candidates;
+    const StopStore &stops;
+    ImprovementBudget budget;
+    int iterations;
+    QVector<int> tour; // route that is improved, the depot stays at position 0
+    QVector<int> position; // position of every stop in the tour
+    QVector<int> queue; // ring buffer of the stops whose don't-look bit is off
+    QVector<bool> queued; // don't-look bit cleared (stop is in the queue)
+    int queueHead, queueSize;
+    int Next(int stop) const { return tour.at(position.at(stop) + 1 == tour.count() ? 0 : position.at(stop) + 1); }
+    int Prev(int stop) const { return tour.at(position.at(stop) - 1); }
+    int NextSkipping(int stop, int a, int b) const; // successor of stop that is neither a nor b
+    bool CanFollow(int stop, int u) const; // true if stop may be placed directly behind u
+    bool ImproveStop(int stop); // applies the first improving move of the stop or of its request
+    bool RelocateStop(int stop); // moves the stop behind a candidate neighbor
+    bool RelocatePair(int pickup); // moves a whole request behind two candidate neighbors
+    void Move(int stop, int u); // moves stop directly behind u and updates the positions
+    void Push(int stop); // clears the don't-look bit of a stop
+};
+
+#endif // PICKUPDELIVERYSEARCH_H
@@ -0,0 +1,31 @@
+#include "planningworker.h"
+
+PlanningWorker::PlanningWorker(DeliveryPlanner *deliveryPlanner):
+    deliveryPlanner(deliveryPlanner),
+    comparing(false)
+{
+    // The planner calls back on this worker's thread; the signals are queued to the viewer
+    deliveryPlanner->SetProgress([this](int placedStops, double length){
+        if(comparing || (progressTimer.isValid() && progressTimer.elapsed() < progressDelay))
+            return;
+        progressTimer.start();
+        emit Progress(placedStops, length);
+    });
+    // The tour itself is taken from the planner's snapshot, the signal only says that there is one
+    deliveryPlanner->SetRouteStream([this](const QVector<double> &, const QVector<double> &, double){
+        emit TourImproved();
+    }, tourDelay);
+}
+
+// Calculates the delivery plan and hands it over, then compares the constructions on its points and
+// calculates the lower bound. A cancel ends the comparison after the running construction and skips the bound.
+void PlanningWorker::Plan(){
+    progressTimer.invalidate();
+    double length = deliveryPlanner->CalculateDeliveryPlan();
+    emit Planned(length);
+    comparing = true;
+    deliveryPlanner->CompareConstructions();
+    comparing = false;
+    double bound = deliveryPlanner->Cancelled() ? 0 : deliveryPlanner->CalculateLowerBound();
+    emit Finished(length, bound);
+}
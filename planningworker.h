@@ -0,0 +1,34 @@
+#ifndef PLANNINGWORKER_H
+#define PLANNINGWORKER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include "deliveryplanner.h"
+
+// Calculates the delivery plan of a planner on the thread it lives on, so that the viewer stays responsive.
+// Planned() hands over the plan as soon as it is calculated; the comparison of the constructions and the
+// lower bound follow. The planner must not be touched by other threads until Finished() is emitted, except
+// for Cancel() and TakePlan(). A cancel is not cleared by Plan(): the caller clears it with ClearCancel()
+// before it queues the plan.
+class PlanningWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    PlanningWorker(DeliveryPlanner *deliveryPlanner);
+public slots:
+    void Plan(); // calculates the plan, the comparison of the constructions and the lower bound
+signals:
+    void Progress(int placedStops, double length); // stops on the route so far and their length (at most every progressDelay ms)
+    void Planned(double length); // the plan is published, the comparison and the lower bound still run
+    void Finished(double length, double bound); // the plan is in the planner (bound 0: not computed because of a cancel)
+    void TourImproved(); // the planner has published a better tour (at most every tourDelay ms)
+private:
+    DeliveryPlanner *deliveryPlanner; // planner that calculates the plan
+    QElapsedTimer progressTimer; // time since the last progress signal
+    bool comparing; // true while the constructions are compared (their progress is not passed on)
+    static const qint64 progressDelay = 100; // minimum time between two progress signals in milliseconds
+    static const qint64 tourDelay = 100; // minimum time between two improved tours in milliseconds
+};
+
+#endif // PLANNINGWORKER_H
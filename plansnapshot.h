@@ -0,0 +1,32 @@
+#ifndef PLANSNAPSHOT_H
+#define PLANSNAPSHOT_H
+
+#include <QVector>
+#include <QSharedPointer>
+#include <atomic>
+
+// State of a plan handed from the calculating thread to the viewer. It is never changed after it is
+// published; its coordinate vectors are implicitly shared, so handing it on copies no coordinates.
+struct PlanSnapshot
+{
+    QVector<double> x, y; // planned route (all vehicle routes joined at the depot)
+    double length; // length of the route
+};
+
+// Single slot for the latest snapshot. Publish() and Take() exchange one atomic pointer, so no side ever
+// waits for the other: a new snapshot replaces one that nobody has taken yet, and a reader gets the latest
+// snapshot and owns it from then on, shared by reference count. Any thread may publish or take.
+class PlanMailbox
+{
+public:
+    PlanMailbox(): slot(nullptr) {}
+    ~PlanMailbox() { delete slot.exchange(nullptr); }
+    void Publish(PlanSnapshot *snapshot) { delete slot.exchange(snapshot, std::memory_order_acq_rel); } // takes ownership
+    QSharedPointer<const PlanSnapshot> Take() { // latest snapshot (null: none published since the last Take())
+        return QSharedPointer<const PlanSnapshot>(slot.exchange(nullptr, std::memory_order_acq_rel));
+    }
+private:
+    std::atomic<PlanSnapshot*> slot; // snapshot that has not been taken yet (nullptr: none)
+};
+
+#endif // PLANSNAPSHOT_H
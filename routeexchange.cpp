@@ -0,0 +1,161 @@
+#include "routeexchange.h"
+
+static const double minimumGain = 1e-10; // smaller gains are treated as rounding noise
+
+RouteExchange::RouteExchange(const DistanceFunction &distance, const CandidateNeighbors &candidates, TimeWindowSchedule &schedule,
+                             const QVector<double> &demand, double capacity, const ImprovementBudget &budget):
+    distance(distance),
+    candidates(candidates),
+    schedule(schedule),
+    demand(demand),
+    capacity(capacity),
+    budget(budget),
+    iterations(0),
+    routes(nullptr),
+    queueHead(0),
+    queueSize(0)
+{
+
+}
+
+// Applies improving moves until no stop has one left or the budget is used up
+double RouteExchange::Optimize(QVector<QVector<int>> &routes){
+    iterations = 0;
+    this->routes = &routes;
+    routeOf.fill(-1, distance.Count());
+    positionOf.fill(-1, distance.Count());
+    loadBefore.resize(routes.count());
+    queue.fill(0, distance.Count());
+    queued.fill(false, distance.Count());
+    queueHead = 0; queueSize = 0;
+    schedule.Build(routes);
+    for(int r = 0; r < routes.count(); r++)
+        UpdateRoute(r); // queues every routed stop
+
+    // A move also changes what the stops next to the two routes can do, so once the queue runs dry
+    // all stops are looked at again until a whole round finds no move
+    BudgetTracker tracker(budget);
+    int roundStart = 0;
+    while(queueSize > 0 && !tracker.Exhausted()){
+        int stop = queue.at(queueHead);
+        queueHead = (queueHead + 1) % queue.count();
+        queueSize--;
+        queued[stop] = false;
+        if(ImproveStop(stop)){
+            tracker.CountIterations();
+            Push(stop);
+        }
+        if(queueSize == 0 && tracker.Iterations() > roundStart){
+            roundStart = tracker.Iterations();
+            for(int stop = 1; stop < distance.Count(); stop++){
+                if(routeOf.at(stop) >= 0)
+                    Push(stop);
+            }
+        }
+    }
+    iterations = tracker.Iterations();
+
+    // Routes that lost all of their stops are not driven
+    double length = 0;
+    for(int r = routes.count() - 1; r >= 0; r--){
+        if(routes.at(r).count() <= 2)
+            routes.remove(r);
+        else
+            length += distance.RouteLength(routes.at(r));
+    }
+    this->routes = nullptr;
+    return length;
+}
+
+// Tries the moves between the stop and its candidate neighbors on other routes
+bool RouteExchange::ImproveStop(int stop){
+    for(const int *neighbor = candidates.Begin(stop); neighbor != candidates.End(stop); neighbor++){
+        if(*neighbor == 0 || routeOf.at(*neighbor) < 0 || routeOf.at(*neighbor) == routeOf.at(stop))
+            continue;
+        if(Relocate(stop, *neighbor) || ExchangeTails(stop, *neighbor))
+            return true;
+    }
+    return false;
+}
+
+// Moves stop directly behind or in front of neighbor
+bool RouteExchange::Relocate(int stop, int neighbor){
+    int routeA = routeOf.at(stop), routeB = routeOf.at(neighbor);
+    const QVector<int> &a = routes->at(routeA);
+    const QVector<int> &b = routes->at(routeB);
+    if(!FitsCapacity(Load(routeB) + demand.at(stop)))
+        return false;
+
+    int i = positionOf.at(stop), j = positionOf.at(neighbor);
+    double removeGain = distance(a.at(i - 1), stop) + distance(stop, a.at(i + 1)) - distance(a.at(i - 1), a.at(i + 1));
+    // Insert before position j + 1 (behind neighbor) or before position j (in front of neighbor)
+    for(int position = j + 1; position >= j; position--){
+        double insertCost = distance(b.at(position - 1), stop) + distance(stop, b.at(position))
+                          - distance(b.at(position - 1), b.at(position));
+        if(removeGain - insertCost <= minimumGain)
+            continue;
+        if(!schedule.CanRemove(routeA, i) || !schedule.CanInsert(routeB, position, stop))
+            continue;
+        (*routes)[routeA].remove(i);
+        (*routes)[routeB].insert(position, stop);
+        UpdateRoute(routeA);
+        UpdateRoute(routeB);
+        return true;
+    }
+    return false;
+}
+
+// Swaps the tails of both routes so that stop is followed by neighbor:
+// A[0, i] + B[j, end) and B[0, j) + A(i, end)
+bool RouteExchange::ExchangeTails(int stop, int neighbor){
+    int routeA = routeOf.at(stop), routeB = routeOf.at(neighbor);
+    const QVector<int> &a = routes->at(routeA);
+    const QVector<int> &b = routes->at(routeB);
+    int i = positionOf.at(stop), j = positionOf.at(neighbor);
+
+    double gain = distance(stop, a.at(i + 1)) + distance(b.at(j - 1), neighbor)
+                - distance(stop, neighbor) - distance(b.at(j - 1), a.at(i + 1));
+    if(gain <= minimumGain)
+        return false;
+    double headA = loadBefore.at(routeA).at(i), headB = loadBefore.at(routeB).at(j - 1);
+    if(!FitsCapacity(headA + Load(routeB) - headB) || !FitsCapacity(headB + Load(routeA) - headA))
+        return false;
+    if(!schedule.CanExchangeTails(routeA, i, routeB, j))
+        return false;
+
+    QVector<int> newA = a.mid(0, i + 1) + b.mid(j);
+    QVector<int> newB = b.mid(0, j) + a.mid(i + 1);
+    (*routes)[routeA] = newA;
+    (*routes)[routeB] = newB;
+    UpdateRoute(routeA);
+    UpdateRoute(routeB);
+    return true;
+}
+
+// Recomputes positions, prefix loads and time segments of a route. Its stops are queued again: the
+// changed loads and times can make moves feasible that were not before.
+void RouteExchange::UpdateRoute(int route){
+    const QVector<int> &stops = routes->at(route);
+    QVector<double> &load = loadBefore[route];
+    load.resize(stops.count());
+    double sum = 0;
+    for(int i = 0; i < stops.count(); i++){
+        if(stops.at(i) != 0){
+            routeOf[stops.at(i)] = route;
+            positionOf[stops.at(i)] = i;
+            Push(stops.at(i));
+        }
+        sum += demand.at(stops.at(i));
+        load[i] = sum;
+    }
+    schedule.Update(*routes, route);
+}
+
+// Clears the don't-look bit of a stop
+void RouteExchange::Push(int stop){
+    if(stop == 0 || queued.at(stop))
+        return;
+    queued[stop] = true;
+    queue[(queueHead + queueSize) % queue.count()] = stop;
+    queueSize++;
+}
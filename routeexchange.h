@@ -0,0 +1,45 @@
+#ifndef ROUTEEXCHANGE_H
+#define ROUTEEXCHANGE_H
+
+#include <QVector>
+#include "distancefunction.h"
+#include "candidateneighbors.h"
+#include "improvementbudget.h"
+#include "timewindows.h"
+
+// Local search between vehicle routes (depot at both ends of every route): a stop is moved next to a
+// candidate neighbor on another route (relocate), or the tails of two routes are swapped so that a stop
+// gets connected to a candidate neighbor (2-opt*). The capacity is checked with the prefix loads and the
+// time windows with the forward/backward segments of the schedule, both in O(1) per move. Stops whose
+// surroundings did not change are skipped (don't-look bits).
+class RouteExchange
+{
+public:
+    RouteExchange(const DistanceFunction &distance, const CandidateNeighbors &candidates, TimeWindowSchedule &schedule,
+                  const QVector<double> &demand, double capacity, const ImprovementBudget &budget);
+    double Optimize(QVector<QVector<int>> &routes); // improves the routes in place (empty routes are dropped) and returns their total length
+    int Iterations() const { return iterations; } // number of moves applied by the last run
+private:
+    const DistanceFunction &distance;
+    const CandidateNeighbors &candidates;
+    TimeWindowSchedule &schedule;
+    const QVector<double> &demand;
+    double capacity; // load limit of a vehicle (<= 0: unlimited)
+    ImprovementBudget budget;
+    int iterations;
+    QVector<QVector<int>> *routes; // routes that are improved
+    QVector<int> routeOf, positionOf; // route and position of every stop
+    QVector<QVector<double>> loadBefore; // load of every route up to and including a position
+    QVector<int> queue; // ring buffer of the stops whose don't-look bit is off
+    QVector<bool> queued; // don't-look bit cleared (stop is in the queue)
+    int queueHead, queueSize;
+    bool ImproveStop(int stop); // applies the first improving move around a stop
+    bool Relocate(int stop, int neighbor); // moves stop next to neighbor if that is shorter and feasible
+    bool ExchangeTails(int stop, int neighbor); // connects stop to neighbor by swapping route tails if that is shorter and feasible
+    double Load(int route) const { return loadBefore.at(route).last(); } // load of a route
+    bool FitsCapacity(double load) const { return capacity <= 0 || load <= capacity; }
+    void UpdateRoute(int route); // recomputes positions, loads and time segments after a move
+    void Push(int stop); // clears the don't-look bit of a stop (the depot is never queued)
+};
+
+#endif // ROUTEEXCHANGE_H
@@ -0,0 +1,24 @@
+#ifndef ROUTESTREAM_H
+#define ROUTESTREAM_H
+
+#include <QVector>
+#include <QElapsedTimer>
+#include <functional>
+
+// Hands the best route an improvement stage has found so far to a receiver, at most once per interval.
+// The stages ask Due() after every improving move, which only reads a timer, and publish their route
+// when it says so.
+class RouteStream
+{
+public:
+    typedef std::function<void(const QVector<int> &route, double length)> Receiver;
+    RouteStream(const Receiver &receiver, qint64 interval): receiver(receiver), interval(interval) { timer.start(); }
+    bool Due() const { return timer.elapsed() >= interval; } // true if the interval has passed since the last route
+    void Publish(const QVector<int> &route, double length) { timer.start(); receiver(route, length); } // hands over a closed route
+private:
+    Receiver receiver; // gets the routes
+    qint64 interval; // minimum time between two routes in milliseconds
+    QElapsedTimer timer; // time since the last route
+};
+
+#endif // ROUTESTREAM_H
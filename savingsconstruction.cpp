@@ -0,0 +1,210 @@
+#include "savingsconstruction.h"
+
+#include <algorithm>
+
+static const int bucketCount = 4096; // buckets of the savings sort
+
+SavingsConstruction::SavingsConstruction(const DistanceFunction &distance, const CandidateNeighbors &candidates,
+                                         const QVector<double> &demand, double capacity, const TimeWindowSchedule *schedule,
+                                         int vehicles):
+    distance(distance),
+    candidates(candidates),
+    demand(demand),
+    capacity(capacity),
+    schedule(schedule),
+    vehicles(vehicles),
+    merges(0)
+{
+
+}
+
+// Starts with one route per stop and joins routes in the order of decreasing savings
+double SavingsConstruction::Construct(const QVector<int> &stops, QVector<QVector<int>> &routes){
+    merges = 0;
+    routes.clear();
+    link.fill(-1, 2 * distance.Count());
+    otherEnd.fill(-1, distance.Count());
+    head.fill(-1, distance.Count());
+    load.fill(0, distance.Count());
+    if(schedule)
+        segment.resize(distance.Count());
+    for(int stop : stops){
+        otherEnd[stop] = stop;
+        head[stop] = stop;
+        load[stop] = demand.at(stop);
+        if(schedule)
+            segment[stop] = schedule->Stop(stop);
+    }
+
+    QVector<Saving> savings;
+    SortedSavings(stops, savings);
+    int routeCount = stops.count();
+    for(const Saving &saving : savings){
+        if(vehicles > 0 && routeCount <= vehicles)
+            break;
+        if(Join(saving.a, saving.b) || Join(saving.b, saving.a)){
+            merges++;
+            routeCount--;
+        }
+    }
+    if(vehicles > 0 && routeCount > vehicles)
+        JoinLeftover(stops, routeCount);
+
+    // Walk every route from its first stop
+    double length = 0;
+    QVector<bool> visited(distance.Count(), false);
+    for(int stop : stops){
+        if(visited.at(stop) || !IsEnd(stop) || head.at(stop) != stop)
+            continue;
+        QVector<int> route;
+        route.append(0);
+        int previous = -1;
+        for(int current = stop; current >= 0; ){
+            route.append(current);
+            visited[current] = true;
+            int next = link.at(2 * current) == previous ? link.at(2 * current + 1) : link.at(2 * current);
+            previous = current;
+            current = next;
+        }
+        route.append(0);
+        for(int i = 0; i + 1 < route.count(); i++)
+            length += distance(route.at(i), route.at(i + 1));
+        routes.append(route);
+    }
+    return length;
+}
+
+// Collects the positive savings of all candidate pairs and sorts them by value, largest first. The
+// values are distributed into buckets first, so only the entries of a bucket have to be compared.
+void SavingsConstruction::SortedSavings(const QVector<int> &stops, QVector<Saving> &savings) const{
+    QVector<Saving> unsorted;
+    double maxSaving = 0;
+    for(int a : stops){
+        for(const int *neighbor = candidates.Begin(a); neighbor != candidates.End(a); neighbor++){
+            int b = *neighbor;
+            if(b == 0 || a == b)
+                continue;
+            // Pairs that are candidates of each other are listed once
+            if(a > b && std::find(candidates.Begin(b), candidates.End(b), a) != candidates.End(b))
+                continue;
+            double value = distance(0, a) + distance(0, b) - distance(a, b);
+            if(value <= 0)
+                continue;
+            Saving saving = {value, qMin(a, b), qMax(a, b)};
+            unsorted.append(saving);
+            maxSaving = qMax(maxSaving, value);
+        }
+    }
+
+    // Counting sort into buckets of decreasing value
+    QVector<int> bucketBegin(bucketCount + 1, 0);
+    auto bucketOf = [&](double value){
+        return bucketCount - 1 - qMin(bucketCount - 1, (int)(value / maxSaving * bucketCount));
+    };
+    for(const Saving &saving : unsorted)
+        bucketBegin[bucketOf(saving.value) + 1]++;
+    for(int bucket = 0; bucket < bucketCount; bucket++)
+        bucketBegin[bucket + 1] += bucketBegin.at(bucket);
+    savings.resize(unsorted.count());
+    QVector<int> fill = bucketBegin;
+    for(const Saving &saving : unsorted)
+        savings[fill[bucketOf(saving.value)]++] = saving;
+
+    // Equal savings are ordered by their stops so that the result does not depend on the input order
+    for(int bucket = 0; bucket < bucketCount; bucket++){
+        std::sort(savings.begin() + bucketBegin.at(bucket), savings.begin() + bucketBegin.at(bucket + 1),
+                  [](const Saving &first, const Saving &second){
+                      if(first.value != second.value)
+                          return first.value > second.value;
+                      return first.a != second.a ? first.a < second.a : first.b < second.b;
+                  });
+    }
+}
+
+// Joins the routes the candidate savings left over until there are as many routes as vehicles. Up to
+// maxLeftover routes, the savings of all pairs of their ends are tried, largest first (they may be
+// negative: the routes have to be joined anyway). Then routes are appended in the order of their first
+// stops. Joins that break the capacity or a window are skipped, so more routes than vehicles can remain.
+void SavingsConstruction::JoinLeftover(const QVector<int> &stops, int &routeCount){
+    QVector<int> ends;
+    for(int stop : stops){
+        if(IsEnd(stop))
+            ends.append(stop);
+    }
+    if(routeCount <= maxLeftover){
+        QVector<Saving> savings;
+        for(int i = 0; i < ends.count(); i++){
+            for(int j = i + 1; j < ends.count(); j++){
+                int a = ends.at(i), b = ends.at(j);
+                if(otherEnd.at(a) == b)
+                    continue;
+                Saving saving = {distance(0, a) + distance(0, b) - distance(a, b), qMin(a, b), qMax(a, b)};
+                savings.append(saving);
+            }
+        }
+        std::sort(savings.begin(), savings.end(), [](const Saving &first, const Saving &second){
+            if(first.value != second.value)
+                return first.value > second.value;
+            return first.a != second.a ? first.a < second.a : first.b < second.b;
+        });
+        for(const Saving &saving : savings){
+            if(routeCount <= vehicles)
+                return;
+            if(Join(saving.a, saving.b) || Join(saving.b, saving.a)){
+                merges++;
+                routeCount--;
+            }
+        }
+    }
+
+    // The last stop of the routes joined so far is joined to the first stop of the next route; if that
+    // fails, the next route starts a new chain
+    int last = -1;
+    for(int stop : ends){
+        if(routeCount <= vehicles)
+            return;
+        if(!IsEnd(stop) || head.at(stop) != stop)
+            continue;
+        int tail = otherEnd.at(stop);
+        if(last >= 0 && Join(last, stop)){
+            merges++;
+            routeCount--;
+        }
+        last = tail;
+    }
+}
+
+// Appends the route that ends at b to the route that ends at a. Both stops have to be ends (connected to
+// the depot) of two different routes whose loads fit into one vehicle. Without time windows the direction
+// of the routes does not matter; with windows a has to be the last stop of its route, b the first one of
+// its route, and the joined route has to meet all windows.
+bool SavingsConstruction::Join(int a, int b){
+    if(!IsEnd(a) || !IsEnd(b) || otherEnd.at(a) == b)
+        return false;
+    double joinedLoad = load.at(a) + load.at(b);
+    if(capacity > 0 && joinedLoad > capacity)
+        return false;
+    TimeSegment joinedSegment;
+    if(schedule){
+        if(head.at(b) != b || (head.at(a) == a && otherEnd.at(a) != a))
+            return false;
+        joinedSegment = schedule->Join(segment.at(a), segment.at(b));
+        TimeSegment depot = schedule->Stop(0);
+        if(!TimeWindowSchedule::Feasible(schedule->Join(schedule->Join(depot, joinedSegment), depot)))
+            return false;
+    }
+
+    // Replace the depot connection of both ends by the new edge
+    link[link.at(2 * a) < 0 ? 2 * a : 2 * a + 1] = b;
+    link[link.at(2 * b) < 0 ? 2 * b : 2 * b + 1] = a;
+
+    // The ends of the joined route are the former other ends; the route now starts where the route of a started
+    int endA = otherEnd.at(a), endB = otherEnd.at(b);
+    otherEnd[endA] = endB; otherEnd[endB] = endA;
+    head[endA] = endA; head[endB] = endA;
+    load[endA] = joinedLoad; load[endB] = joinedLoad;
+    if(schedule){
+        segment[endA] = joinedSegment; segment[endB] = joinedSegment;
+    }
+    return true;
+}
@@ -0,0 +1,51 @@
+#ifndef SAVINGSCONSTRUCTION_H
+#define SAVINGSCONSTRUCTION_H
+
+#include <QVector>
+#include "distancefunction.h"
+#include "candidateneighbors.h"
+#include "timewindows.h"
+
+// Clarke-Wright savings construction for vehicles with a capacity. Every stop starts on its own route
+// from the depot (stop 0); two routes are joined at their ends in the order of decreasing saving
+// d(0, a) + d(0, b) - d(a, b) as long as the joined load fits into a vehicle. Only pairs of candidate
+// neighbors are considered, so the savings list has O(n k) entries. With a time window schedule the routes
+// keep their direction: the first route has to end at a and the second one has to start at b, and the
+// joined route has to meet every window, which is checked in O(1) from the segments of both routes.
+// With a number of vehicles the joins stop once there are as many routes as vehicles. Routes that are
+// left over after the candidate savings are joined over all pairs of their ends, largest saving first,
+// and then in the order of their first stops, as long as the loads and windows allow it.
+class SavingsConstruction
+{
+public:
+    SavingsConstruction(const DistanceFunction &distance, const CandidateNeighbors &candidates,
+                        const QVector<double> &demand, double capacity, const TimeWindowSchedule *schedule = nullptr,
+                        int vehicles = 0);
+    // Routes the stops (depot excluded) and returns the total length; every route starts and ends at the depot
+    double Construct(const QVector<int> &stops, QVector<QVector<int>> &routes);
+    int Merges() const { return merges; } // number of joins of the last run
+    static const int maxLeftover = 1024; // most leftover routes whose ends are paired with each other
+private:
+    struct Saving {
+        double value; // length that is saved by the join
+        int a, b; // stops that get connected (a < b)
+    };
+    const DistanceFunction &distance;
+    const CandidateNeighbors &candidates;
+    const QVector<double> &demand;
+    double capacity; // load limit of a vehicle (<= 0: unlimited)
+    const TimeWindowSchedule *schedule; // time windows of the stops (nullptr: no windows)
+    int vehicles; // number of routes the joins stop at (0: unlimited)
+    int merges;
+    QVector<int> link; // two neighbors of every stop on its route (-1: the depot)
+    QVector<int> otherEnd; // route ends: stop at the other end of the route
+    QVector<int> head; // route ends: first stop of the route
+    QVector<double> load; // route ends: load of the route
+    QVector<TimeSegment> segment; // route ends: time segment of the route from its first to its last stop
+    void SortedSavings(const QVector<int> &stops, QVector<Saving> &savings) const; // positive savings, largest first
+    void JoinLeftover(const QVector<int> &stops, int &routeCount); // joins leftover routes until there are as many as vehicles
+    bool Join(int a, int b); // appends the route that ends at b to the route that ends at a if possible
+    bool IsEnd(int stop) const { return link.at(2 * stop) < 0 || link.at(2 * stop + 1) < 0; } // true if the stop is connected to the depot
+};
+
+#endif // SAVINGSCONSTRUCTION_H
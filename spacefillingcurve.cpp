@@ -0,0 +1,75 @@
+#include "spacefillingcurve.h"
+#include "parallelsort.h"
+
+#include <algorithm>
+
+static const int curveOrder = 20; // the curve runs through a grid of 2^20 x 2^20 cells
+
+SpaceFillingCurve::SpaceFillingCurve(const QVector<double> &x, const QVector<double> &y, int threadCount):
+    x(x),
+    y(y),
+    threadCount(threadCount)
+{
+
+}
+
+// Visits the stops in curve order, starting with the first given stop
+void SpaceFillingCurve::Construct(const QVector<int> &stops, QVector<int> &route) const{
+    Sort(stops, route);
+    if(!route.isEmpty())
+        std::rotate(route.begin(), std::find(route.begin(), route.end(), stops.at(0)), route.end());
+}
+
+// Sorts the stops by their curve key; the keys are computed in parallel
+void SpaceFillingCurve::Sort(const QVector<int> &stops, QVector<int> &order) const{
+    int count = stops.count();
+    order.clear();
+    if(count == 0)
+        return;
+
+    double minX = x.at(stops.at(0)), maxX = minX;
+    double minY = y.at(stops.at(0)), maxY = minY;
+    for(int stop : stops){
+        minX = std::min(minX, x.at(stop)); maxX = std::max(maxX, x.at(stop));
+        minY = std::min(minY, y.at(stop)); maxY = std::max(maxY, y.at(stop));
+    }
+    // The same scale on both axes keeps the cells square
+    double side = std::max(maxX - minX, maxY - minY);
+    double scale = side > 0 ? ((1 << curveOrder) - 1) / side : 0;
+
+    QVector<Key> keys(count);
+    Key *data = keys.data(); // detach once, before the threads write to it
+    ParallelFor(count, threadCount, [&](int begin, int end, int){
+        for(int i = begin; i < end; i++){
+            int stop = stops.at(i);
+            quint32 gridX = (quint32)((x.at(stop) - minX) * scale);
+            quint32 gridY = (quint32)((y.at(stop) - minY) * scale);
+            data[i] = Key(HilbertKey(gridX, gridY), stop);
+        }
+    });
+    ParallelSort(keys, threadCount);
+
+    order.resize(count);
+    for(int i = 0; i < count; i++)
+        order[i] = keys.at(i).second;
+}
+
+// Position of the cell (gridX, gridY) on the Hilbert curve of order curveOrder: in every level the
+// quadrant gives two bits, then the cell is rotated into the orientation of the curve in that quadrant
+quint64 SpaceFillingCurve::HilbertKey(quint32 gridX, quint32 gridY){
+    const quint32 side = 1u << curveOrder;
+    quint64 key = 0;
+    for(quint32 half = side / 2; half > 0; half /= 2){
+        quint32 right = (gridX & half) ? 1 : 0;
+        quint32 top = (gridY & half) ? 1 : 0;
+        key += (quint64)half * half * ((3 * right) ^ top);
+        if(top == 0){
+            if(right == 1){
+                gridX = side - 1 - gridX;
+                gridY = side - 1 - gridY;
+            }
+            std::swap(gridX, gridY);
+        }
+    }
+    return key;
+}
@@ -0,0 +1,25 @@
+#ifndef SPACEFILLINGCURVE_H
+#define SPACEFILLINGCURVE_H
+
+#include <QVector>
+#include <QPair>
+
+// Space-filling-curve construction: the stops are visited in the order of their position on a Hilbert
+// curve through the bounding box of all stops. Points that are close on the curve are close in the plane,
+// so the tour is about 25% longer than an optimal one, but it takes only a sort. The curve keys are
+// computed in parallel and sorted with a parallel merge sort (ParallelSort), O(n log n) in total.
+class SpaceFillingCurve
+{
+public:
+    SpaceFillingCurve(const QVector<double> &x, const QVector<double> &y, int threadCount = 0);
+    // Fills route with the stops in curve order, rotated so that it starts with the first given stop
+    void Construct(const QVector<int> &stops, QVector<int> &route) const;
+    void Sort(const QVector<int> &stops, QVector<int> &order) const; // fills order with the stops in curve order
+private:
+    typedef QPair<quint64, int> Key; // position on the curve and stop
+    const QVector<double> &x, &y;
+    int threadCount;
+    static quint64 HilbertKey(quint32 gridX, quint32 gridY); // position of a grid cell on the curve
+};
+
+#endif // SPACEFILLINGCURVE_H
@@ -0,0 +1,383 @@
+#include "spatialindex.h"
+
+#include <QPair>
+#include <QVarLengthArray>
+#include <algorithm>
+
+static const int leafCapacity = 8; // maximum number of points in a leaf
+
+SpatialIndex::SpatialIndex()
+{
+
+}
+
+// Builds the tree over all points (x[i], y[i]); the id of a point is its index i
+void SpatialIndex::Build(const QVector<double> &x, const QVector<double> &y){
+    int count = x.count();
+    // The vectors of the last tree are reused: resize() keeps their capacity. While the tree is built the
+    // slots hold the points by id.
+    nodes.clear();
+    slotX.resize(count); slotY.resize(count);
+    std::copy(x.constBegin(), x.constEnd(), slotX.begin());
+    std::copy(y.constBegin(), y.constEnd(), slotY.begin());
+    slotId.resize(count);
+    slotOf.resize(count);
+    leafOf.resize(count);
+    if(count == 0)
+        return;
+
+    buildOrder.resize(count);
+    for(int i = 0; i < count; i++)
+        buildOrder[i] = i;
+    nodes.reserve(2 * (count / leafCapacity + 1));
+    BuildNode(buildOrder, 0, count, -1);
+
+    // Store the points leaf by leaf so that a leaf scan reads contiguous memory
+    for(int i = 0; i < count; i++){
+        slotId[i] = buildOrder[i];
+        slotX[i] = x.at(buildOrder[i]);
+        slotY[i] = y.at(buildOrder[i]);
+        slotOf[buildOrder[i]] = i;
+    }
+}
+
+// Removes all points; the memory stays for the next Build()
+void SpatialIndex::Clear(){
+    nodes.clear();
+    slotX.clear(); slotY.clear();
+    slotId.clear();
+    slotOf.clear();
+    leafOf.clear();
+}
+
+// Builds the subtree over order[begin, end) and returns the index of its root node
+int SpatialIndex::BuildNode(QVector<int> &order, int begin, int end, int parent){
+    Node node;
+    node.minX = node.maxX = slotX.at(order[begin]);
+    node.minY = node.maxY = slotY.at(order[begin]);
+    for(int i = begin + 1; i < end; i++){
+        node.minX = std::min(node.minX, slotX.at(order[i])); node.maxX = std::max(node.maxX, slotX.at(order[i]));
+        node.minY = std::min(node.minY, slotY.at(order[i])); node.maxY = std::max(node.maxY, slotY.at(order[i]));
+    }
+    node.left = -1; node.right = -1;
+    node.parent = parent;
+    node.begin = begin;
+    node.size = end - begin;
+    node.alive = end - begin;
+    node.capacity = end - begin;
+
+    int index = nodes.count();
+    nodes.append(node);
+
+    if(end - begin <= leafCapacity){
+        for(int i = begin; i < end; i++)
+            leafOf[order[i]] = index;
+        return index;
+    }
+
+    // Split at the median of the wider side of the bounding box
+    int middle = begin + (end - begin) / 2;
+    const QVector<double> &coordinate = (node.maxX - node.minX >= node.maxY - node.minY) ? slotX : slotY;
+    std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+                     [&coordinate](int a, int b){ return coordinate.at(a) < coordinate.at(b); });
+
+    int left = BuildNode(order, begin, middle, index);
+    int right = BuildNode(order, middle, end, index);
+    nodes[index].left = left;
+    nodes[index].right = right;
+    return index;
+}
+
+// Squared distance between the point (x, y) and the bounding box of a node (0 if inside)
+static inline double BoxDistance(double minX, double minY, double maxX, double maxY, double x, double y){
+    double dx = x < minX ? minX - x : (x > maxX ? x - maxX : 0);
+    double dy = y < minY ? minY - y : (y > maxY ? y - maxY : 0);
+    return dx * dx + dy * dy;
+}
+
+// Adds the point (x, y) with the next free id without rebuilding the tree: it goes into the leaf whose box
+// is closest to it, and a full leaf is split at its median first (the second half moves to free slots at
+// the end of the slot arrays). So an insertion walks one path of the tree like a search does. Insertions
+// do not balance the tree; Build() does.
+int SpatialIndex::Insert(double x, double y){
+    int id = slotOf.count();
+    if(nodes.isEmpty()){
+        Node node;
+        node.minX = node.maxX = x;
+        node.minY = node.maxY = y;
+        node.left = -1; node.right = -1;
+        node.parent = -1;
+        node.begin = slotX.count();
+        node.size = 0; node.alive = 0;
+        node.capacity = leafCapacity;
+        nodes.append(node);
+        slotX.resize(node.begin + leafCapacity);
+        slotY.resize(node.begin + leafCapacity);
+        slotId.resize(node.begin + leafCapacity);
+    }
+
+    // Go down to the closest leaf (left on ties) that has a free slot
+    int leaf = 0;
+    for(;;){
+        if(nodes.at(leaf).left < 0){
+            if(nodes.at(leaf).size < nodes.at(leaf).capacity)
+                break;
+            SplitLeaf(leaf);
+        }
+        const Node &left = nodes.at(nodes.at(leaf).left);
+        const Node &right = nodes.at(nodes.at(leaf).right);
+        leaf = BoxDistance(left.minX, left.minY, left.maxX, left.maxY, x, y) <=
+               BoxDistance(right.minX, right.minY, right.maxX, right.maxY, x, y) ? nodes.at(leaf).left : nodes.at(leaf).right;
+    }
+
+    // The new point is alive, so it takes the place of the first removed point of the leaf, which moves to the free slot
+    Node &node = nodes[leaf];
+    int slot = node.begin + node.size;
+    int first = node.begin + node.alive;
+    if(first != slot){
+        slotX[slot] = slotX.at(first);
+        slotY[slot] = slotY.at(first);
+        slotId[slot] = slotId.at(first);
+        slotOf[slotId.at(slot)] = slot;
+    }
+    slotX[first] = x;
+    slotY[first] = y;
+    slotId[first] = id;
+    slotOf.append(first);
+    leafOf.append(leaf);
+    if(node.size == 0){
+        node.minX = node.maxX = x;
+        node.minY = node.maxY = y;
+    }
+    node.size++;
+
+    for(int i = leaf; i >= 0; i = nodes.at(i).parent){
+        Node &parent = nodes[i];
+        parent.alive++;
+        parent.minX = std::min(parent.minX, x); parent.maxX = std::max(parent.maxX, x);
+        parent.minY = std::min(parent.minY, y); parent.maxY = std::max(parent.maxY, y);
+    }
+    return id;
+}
+
+// Splits a full leaf at the median of the wider side of its box: the first half stays in its slots, the
+// second half moves to leafCapacity new slots. Both halves keep their alive points first.
+void SpatialIndex::SplitLeaf(int leaf){
+    const Node old = nodes.at(leaf);
+    struct Point {
+        double x, y;
+        int id;
+        bool alive;
+    };
+    QVarLengthArray<Point, 16> points;
+    for(int i = old.begin; i < old.begin + old.size; i++){
+        Point point = {slotX.at(i), slotY.at(i), slotId.at(i), i < old.begin + old.alive};
+        points.append(point);
+    }
+    bool alongX = old.maxX - old.minX >= old.maxY - old.minY;
+    std::sort(points.begin(), points.end(), [alongX](const Point &a, const Point &b){
+        double first = alongX ? a.x : a.y, second = alongX ? b.x : b.y;
+        return first < second || (first == second && a.id < b.id);
+    });
+
+    int freeBegin = slotX.count();
+    slotX.resize(freeBegin + leafCapacity);
+    slotY.resize(freeBegin + leafCapacity);
+    slotId.resize(freeBegin + leafCapacity);
+
+    int middle = points.size() / 2;
+    for(int half = 0; half < 2; half++){
+        Node child;
+        child.left = -1; child.right = -1;
+        child.parent = leaf;
+        child.begin = half == 0 ? old.begin : freeBegin;
+        child.capacity = half == 0 ? old.capacity : leafCapacity;
+        child.size = 0; child.alive = 0;
+        int index = nodes.count();
+        int begin = half == 0 ? 0 : middle, end = half == 0 ? middle : points.size();
+        child.minX = child.maxX = points[begin].x;
+        child.minY = child.maxY = points[begin].y;
+        // Alive points first, then the removed ones
+        for(int pass = 0; pass < 2; pass++){
+            for(int i = begin; i < end; i++){
+                const Point &point = points[i];
+                if(point.alive != (pass == 0))
+                    continue;
+                int slot = child.begin + child.size;
+                slotX[slot] = point.x;
+                slotY[slot] = point.y;
+                slotId[slot] = point.id;
+                slotOf[point.id] = slot;
+                leafOf[point.id] = index;
+                child.size++;
+                child.alive += point.alive;
+                child.minX = std::min(child.minX, point.x); child.maxX = std::max(child.maxX, point.x);
+                child.minY = std::min(child.minY, point.y); child.maxY = std::max(child.maxY, point.y);
+            }
+        }
+        nodes.append(child);
+        if(half == 0)
+            nodes[leaf].left = index;
+        else
+            nodes[leaf].right = index;
+    }
+}
+
+// Returns the id of the remaining point closest to (x, y). Ties are broken towards the lowest id,
+// which is the point a linear scan over the ids in ascending order would find first.
+int SpatialIndex::Nearest(double x, double y) const{
+    if(nodes.isEmpty() || nodes.at(0).alive == 0)
+        return -1;
+
+    int bestId = -1;
+    double bestDistance = 0;
+    QVarLengthArray<int, 128> stack;
+    stack.append(0);
+    while(!stack.isEmpty()){
+        const Node &node = nodes.at(stack.last());
+        stack.removeLast();
+        if(node.alive == 0)
+            continue;
+        // Prune strictly farther boxes only: an equally distant point with a lower id has to win
+        if(bestId >= 0 && BoxDistance(node.minX, node.minY, node.maxX, node.maxY, x, y) > bestDistance)
+            continue;
+
+        if(node.left < 0){
+            for(int i = node.begin; i < node.begin + node.alive; i++){
+                double dx = slotX.at(i) - x;
+                double dy = slotY.at(i) - y;
+                double distance = dx * dx + dy * dy;
+                if(bestId < 0 || distance < bestDistance || (distance == bestDistance && slotId.at(i) < bestId)){
+                    bestDistance = distance;
+                    bestId = slotId.at(i);
+                }
+            }
+            continue;
+        }
+
+        // Visit the closer child first (it is pushed last)
+        const Node &left = nodes.at(node.left);
+        const Node &right = nodes.at(node.right);
+        double leftDistance = BoxDistance(left.minX, left.minY, left.maxX, left.maxY, x, y);
+        double rightDistance = BoxDistance(right.minX, right.minY, right.maxX, right.maxY, x, y);
+        if(leftDistance <= rightDistance){
+            stack.append(node.right); stack.append(node.left);
+        }else{
+            stack.append(node.left); stack.append(node.right);
+        }
+    }
+    return bestId;
+}
+
+// Fills result with the ids of the (up to) k remaining points closest to (x, y), sorted by distance
+// (lowest id first on ties)
+void SpatialIndex::KNearest(double x, double y, int k, QVector<int> &result) const{
+    result.clear();
+    if(k <= 0 || nodes.isEmpty() || nodes.at(0).alive == 0)
+        return;
+
+    // Max-heap of the best candidates so far, the worst candidate is on top
+    typedef QPair<double, int> Candidate;
+    QVarLengthArray<Candidate, 32> heap;
+    QVarLengthArray<int, 128> stack;
+    stack.append(0);
+    while(!stack.isEmpty()){
+        const Node &node = nodes.at(stack.last());
+        stack.removeLast();
+        if(node.alive == 0)
+            continue;
+        if(heap.size() == k && BoxDistance(node.minX, node.minY, node.maxX, node.maxY, x, y) > heap[0].first)
+            continue;
+
+        if(node.left < 0){
+            for(int i = node.begin; i < node.begin + node.alive; i++){
+                double dx = slotX.at(i) - x;
+                double dy = slotY.at(i) - y;
+                Candidate candidate(dx * dx + dy * dy, slotId.at(i));
+                if(heap.size() < k){
+                    heap.append(candidate);
+                    std::push_heap(heap.begin(), heap.end());
+                }else if(candidate < heap[0]){
+                    std::pop_heap(heap.begin(), heap.end());
+                    heap.last() = candidate;
+                    std::push_heap(heap.begin(), heap.end());
+                }
+            }
+            continue;
+        }
+
+        const Node &left = nodes.at(node.left);
+        const Node &right = nodes.at(node.right);
+        double leftDistance = BoxDistance(left.minX, left.minY, left.maxX, left.maxY, x, y);
+        double rightDistance = BoxDistance(right.minX, right.minY, right.maxX, right.maxY, x, y);
+        if(leftDistance <= rightDistance){
+            stack.append(node.right); stack.append(node.left);
+        }else{
+            stack.append(node.left); stack.append(node.right);
+        }
+    }
+
+    std::sort_heap(heap.begin(), heap.end());
+    for(int i = 0; i < heap.size(); i++)
+        result.append(heap[i].second);
+}
+
+// Removes a point: it is swapped behind the remaining points of its leaf
+void SpatialIndex::Remove(int id){
+    if(!Contains(id))
+        return;
+    int leaf = leafOf.at(id);
+    int slot = slotOf.at(id);
+    int last = nodes.at(leaf).begin + nodes.at(leaf).alive - 1;
+
+    int lastId = slotId.at(last);
+    std::swap(slotX[slot], slotX[last]);
+    std::swap(slotY[slot], slotY[last]);
+    std::swap(slotId[slot], slotId[last]);
+    slotOf[lastId] = slot;
+    slotOf[id] = last;
+
+    for(int node = leaf; node >= 0; node = nodes.at(node).parent)
+        nodes[node].alive--;
+}
+
+// Brings back a removed point: it is swapped to the front of the removed points of its leaf
+void SpatialIndex::Restore(int id){
+    if(id < 0 || id >= slotOf.count() || nodes.isEmpty() || Contains(id))
+        return;
+    int leaf = leafOf.at(id);
+    int slot = slotOf.at(id);
+    int first = nodes.at(leaf).begin + nodes.at(leaf).alive;
+
+    int firstId = slotId.at(first);
+    std::swap(slotX[slot], slotX[first]);
+    std::swap(slotY[slot], slotY[first]);
+    std::swap(slotId[slot], slotId[first]);
+    slotOf[firstId] = slot;
+    slotOf[id] = first;
+
+    for(int node = leaf; node >= 0; node = nodes.at(node).parent)
+        nodes[node].alive++;
+}
+
+// Brings back all removed points: they are still stored behind the remaining points of their leaf
+void SpatialIndex::RestoreAll(){
+    // Children are created after their parent, so a backward pass sees them first
+    for(int i = nodes.count() - 1; i >= 0; i--){
+        Node &node = nodes[i];
+        node.alive = node.left < 0 ? node.size : nodes.at(node.left).alive + nodes.at(node.right).alive;
+    }
+}
+
+// True if the point has not been removed yet
+bool SpatialIndex::Contains(int id) const{
+    if(id < 0 || id >= slotOf.count() || nodes.isEmpty())
+        return false;
+    const Node &leaf = nodes.at(leafOf.at(id));
+    return slotOf.at(id) < leaf.begin + leaf.alive;
+}
+
+// Number of remaining points
+int SpatialIndex::Count() const{
+    return nodes.isEmpty() ? 0 : nodes.at(0).alive;
+}
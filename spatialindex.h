@@ -0,0 +1,42 @@
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include <QVector>
+
+// k-d tree over a set of points that supports deleting points while it is queried.
+// Points are identified by the id (index) they have in the coordinate vectors passed to Build().
+class SpatialIndex
+{
+public:
+    SpatialIndex();
+    void Build(const QVector<double> &x, const QVector<double> &y); // builds the tree over all points
+    void Clear(); // removes all points, keeps the memory for the next Build()
+    int Insert(double x, double y); // adds a point to the closest leaf, returns its id (the next free index)
+    int Nearest(double x, double y) const; // id of the closest remaining point (lowest id on ties), -1 if empty
+    void KNearest(double x, double y, int k, QVector<int> &result) const; // ids of the k closest remaining points, closest first
+    void Remove(int id); // removes a point from the tree (no-op if it is not contained)
+    void Restore(int id); // brings back a removed point (no-op if it is contained)
+    void RestoreAll(); // brings back all removed points
+    bool Contains(int id) const; // true if the point is still part of the tree
+    int Count() const; // number of remaining points
+private:
+    struct Node {
+        double minX, minY, maxX, maxY; // bounding box of the points below this node
+        int left, right; // child nodes (-1 for leaves)
+        int parent; // parent node (-1 for the root)
+        int begin; // leaves: first slot of the leaf
+        int size; // leaves: number of slots of the leaf
+        int capacity; // leaves: number of slots reserved for the leaf (more than size for leaves of inserted points)
+        int alive; // number of remaining points below this node
+    };
+    QVector<Node> nodes; // nodes of the tree, the root is at index 0
+    QVector<double> slotX, slotY; // coordinates of the points stored leaf by leaf
+    QVector<int> slotId; // ids of the points stored leaf by leaf (alive points first in every leaf)
+    QVector<int> slotOf; // slot of every id, stays valid after removal (removed: the slot is at or past begin + alive of its leaf)
+    QVector<int> leafOf; // leaf of every id
+    QVector<int> buildOrder; // ids in slot order while the tree is built
+    int BuildNode(QVector<int> &order, int begin, int end, int parent); // recursively builds the tree over order[begin, end)
+    void SplitLeaf(int leaf); // turns a full leaf into an inner node over two leaves with free slots
+};
+
+#endif // SPATIALINDEX_H
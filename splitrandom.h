@@ -0,0 +1,27 @@
+#ifndef SPLITRANDOM_H
+#define SPLITRANDOM_H
+
+#include <QtGlobal>
+
+// Seeded random numbers (SplitMix64) that can be split into independent generators for parallel tasks.
+// The generator of a task only depends on the seed and the number of the task, not on the thread that
+// runs it or on the order the tasks run in, so randomized stages give the same result with any number
+// of threads. The numbers are the same on every platform.
+class SplitRandom
+{
+public:
+    explicit SplitRandom(quint64 seed = 1): state(seed) {}
+    SplitRandom Split(quint64 task) const { return SplitRandom(Mix(state ^ Mix(task + increment))); } // generator of a task (this one does not advance)
+    quint64 Next() { state += increment; return Mix(state); } // next random number
+    int Uniform(int low, int high) { return low + (int)(Next() % (quint64)(high - low + 1)); } // random number in [low, high]
+private:
+    static const quint64 increment = 0x9e3779b97f4a7c15ULL;
+    quint64 state;
+    static quint64 Mix(quint64 z) {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+};
+
+#endif // SPLITRANDOM_H
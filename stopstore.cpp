@@ -0,0 +1,39 @@
+#include "stopstore.h"
+
+StopStore::StopStore()
+{
+
+}
+
+// Removes all stops
+void StopStore::Clear(){
+    x.resize(0); y.resize(0);
+    kind.resize(0);
+    id.resize(0);
+    demand.resize(0);
+    earliest.resize(0); latest.resize(0);
+    serviceTime.resize(0);
+    partner.resize(0);
+}
+
+// Reserves memory for count stops
+void StopStore::Reserve(int count){
+    x.reserve(count); y.reserve(count);
+    kind.reserve(count);
+    id.reserve(count);
+    demand.reserve(count);
+    earliest.reserve(count); latest.reserve(count);
+    serviceTime.reserve(count);
+    partner.reserve(count);
+}
+
+// Adds a stop at the end
+void StopStore::Append(double x, double y, StopKind kind, int id, double demand, const TimeWindow &window, int partner){
+    this->x.append(x); this->y.append(y);
+    this->kind.append(kind);
+    this->id.append(id);
+    this->demand.append(demand);
+    this->earliest.append(window.earliest); this->latest.append(window.latest);
+    this->serviceTime.append(window.serviceTime);
+    this->partner.append(partner);
+}
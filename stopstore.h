@@ -0,0 +1,46 @@
+#ifndef STOPSTORE_H
+#define STOPSTORE_H
+
+#include <QVector>
+#include <limits>
+
+// Kind of a stop of the delivery plan
+enum StopKind{
+    depotStop,
+    deliveryStop,
+    pickupStop,
+    requestPickupStop, // pickup of a request, has to be visited before its delivery
+    requestDeliveryStop // delivery of a request
+};
+
+// Time in which the service at a stop has to start, and how long the service takes
+struct TimeWindow
+{
+    double earliest; // earliest start of the service (a vehicle that arrives earlier waits)
+    double latest; // latest start of the service
+    double serviceTime; // duration of the service
+    TimeWindow(double earliest = 0, double latest = std::numeric_limits<double>::infinity(), double serviceTime = 0):
+        earliest(earliest), latest(latest), serviceTime(serviceTime) {}
+};
+
+// Contiguous struct-of-arrays storage of all stops of a planning run. Stop i is (x[i], y[i]) of kind
+// kind[i]; id[i] is its index among the points of that kind. Routes are index arrays into the store.
+class StopStore
+{
+public:
+    StopStore();
+    QVector<double> x, y; // coordinates of the stops
+    QVector<StopKind> kind; // kind of the stops
+    QVector<int> id; // index of the stops among the points of their kind
+    QVector<double> demand; // load the stops take from a vehicle
+    QVector<double> earliest, latest; // time window of the stops
+    QVector<double> serviceTime; // service duration of the stops
+    QVector<int> partner; // other stop of the request of a request stop (-1 for all other stops)
+    void Clear(); // removes all stops (the memory is kept for the next run)
+    void Reserve(int count); // reserves memory for count stops
+    void Append(double x, double y, StopKind kind, int id, double demand = 0, const TimeWindow &window = TimeWindow(),
+                int partner = -1); // adds a stop at the end
+    int Count() const { return x.count(); } // number of stops
+};
+
+#endif // STOPSTORE_H
@@ -0,0 +1,130 @@
+#include "taskscheduler.h"
+
+static thread_local TaskScheduler *currentScheduler = nullptr; // pool of the calling thread
+static thread_local int currentWorker = 0; // deque of the calling thread in its pool
+
+TaskScheduler::TaskScheduler(int threadCount):
+    threadCount(threadCount > 0 ? threadCount : qMax(1, QThread::idealThreadCount())),
+    queued(0),
+    stopping(false)
+{
+    for(int i = 0; i < this->threadCount; i++)
+        queues.push_back(new Queue());
+    for(int worker = 1; worker < this->threadCount; worker++)
+        threads.emplace_back(&TaskScheduler::WorkerLoop, this, worker);
+}
+
+// Stops the workers; no loop may be running
+TaskScheduler::~TaskScheduler(){
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(std::thread &thread : threads)
+        thread.join();
+    for(Queue *queue : queues)
+        delete queue;
+}
+
+// The pool of the calling thread: its own one for workers, the one of the innermost Scope otherwise
+TaskScheduler *TaskScheduler::Current(){
+    return currentScheduler;
+}
+
+// Splits [0, count) into chunks contiguous parts (as ParallelFor does) and runs body on each. The caller runs
+// the first chunk and queues the others on its deque, then runs queued chunks until its own are done.
+void TaskScheduler::ParallelFor(int count, int chunks, const Body &body){
+    chunks = qMin(chunks, count);
+    if(chunks <= 1){
+        if(count > 0)
+            body(0, count, 0);
+        return;
+    }
+
+    int worker = currentScheduler == this ? currentWorker : 0;
+    std::atomic<int> pending(chunks - 1);
+    {
+        Queue &queue = *queues.at(worker);
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        // The newest chunk is taken first by its owner, so the last chunks go in first
+        for(int chunk = chunks - 1; chunk >= 1; chunk--){
+            Task task = {&body, (int)((long long)count * chunk / chunks), (int)((long long)count * (chunk + 1) / chunks), chunk, &pending};
+            queue.tasks.push_back(task);
+        }
+        queued += chunks - 1;
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_all();
+
+    body(0, (int)((long long)count / chunks), 0);
+    while(pending.load(std::memory_order_acquire) > 0){
+        if(!RunTask(worker))
+            std::this_thread::yield();
+    }
+}
+
+// Takes the newest chunk of the own deque or else the oldest chunk of another deque, and runs it
+bool TaskScheduler::RunTask(int worker){
+    Task task;
+    bool found = false;
+    for(int i = 0; i < threadCount && !found; i++){
+        int victim = (worker + i) % threadCount;
+        Queue &queue = *queues.at(victim);
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(queue.tasks.empty())
+            continue;
+        if(i == 0){
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        }else{
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+        found = true;
+    }
+    if(!found)
+        return false;
+    queued--;
+
+    // Loops started by the chunk queue their chunks on this thread's deque
+    TaskScheduler *scheduler = currentScheduler;
+    int previousWorker = currentWorker;
+    currentScheduler = this;
+    currentWorker = worker;
+    (*task.body)(task.begin, task.end, task.chunk);
+    currentScheduler = scheduler;
+    currentWorker = previousWorker;
+    task.pending->fetch_sub(1, std::memory_order_acq_rel);
+    return true;
+}
+
+// Runs chunks and sleeps while there are none
+void TaskScheduler::WorkerLoop(int worker){
+    currentScheduler = this;
+    currentWorker = worker;
+    for(;;){
+        if(RunTask(worker))
+            continue;
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this]{ return stopping || queued.load() > 0; });
+        if(stopping)
+            return;
+    }
+}
+
+TaskScheduler::Scope::Scope(TaskScheduler *scheduler):
+    installed(currentScheduler == nullptr && scheduler != nullptr)
+{
+    if(installed){
+        currentScheduler = scheduler;
+        currentWorker = 0;
+    }
+}
+
+TaskScheduler::Scope::~Scope(){
+    if(installed)
+        currentScheduler = nullptr;
+}
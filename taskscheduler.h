@@ -0,0 +1,58 @@
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include <QThread>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool that runs the chunks of parallel loops. Every worker thread has its own deque: it
+// takes its newest chunk from the back, idle workers steal the oldest chunks of the others from the front.
+// A thread that waits for its chunks runs other chunks meanwhile, so loops can be nested (a chunk may
+// start a parallel loop of its own) and all of them share the threads of one pool instead of starting
+// threads of their own. Threads outside the pool share one further deque.
+class TaskScheduler
+{
+public:
+    typedef std::function<void(int begin, int end, int chunk)> Body;
+    explicit TaskScheduler(int threadCount = 0); // starts threadCount - 1 workers, the caller is the last thread (0: one per core)
+    ~TaskScheduler();
+    int ThreadCount() const { return threadCount; } // number of threads that run chunks at the same time
+    void ParallelFor(int count, int chunks, const Body &body); // runs body on chunks contiguous chunks of [0, count), returns when all are done
+    static TaskScheduler *Current(); // pool the calling thread belongs to (nullptr: none)
+
+    // Makes a pool the current one of the calling thread while it exists, unless the thread already has one
+    class Scope
+    {
+    public:
+        explicit Scope(TaskScheduler *scheduler);
+        ~Scope();
+    private:
+        bool installed; // true if the pool was made current (and has to be removed again)
+    };
+private:
+    struct Task {
+        const Body *body; // loop the chunk belongs to
+        int begin, end, chunk;
+        std::atomic<int> *pending; // chunks of the loop that are not done yet
+    };
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+    int threadCount;
+    std::vector<Queue*> queues; // [0]: threads outside the pool, [i]: worker i
+    std::vector<std::thread> threads; // the workers 1 .. threadCount - 1
+    std::atomic<int> queued; // number of chunks in all deques
+    std::mutex sleepMutex; // guards the sleep of idle workers
+    std::condition_variable wake; // wakes idle workers when chunks are queued or the pool stops
+    bool stopping; // set by the destructor
+    void WorkerLoop(int worker); // runs chunks until the pool stops
+    bool RunTask(int worker); // runs one chunk (own deque first, then stolen), false if there was none
+};
+
+#endif // TASKSCHEDULER_H
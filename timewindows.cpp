@@ -0,0 +1,89 @@
+#include "timewindows.h"
+
+#include <algorithm>
+
+TimeWindowSchedule::TimeWindowSchedule(const DistanceFunction &distance, const StopStore &stops, double speed):
+    distance(distance),
+    stops(stops),
+    speed(speed > 0 ? speed : 1)
+{
+
+}
+
+// A single stop: its service takes serviceTime and has to start in its window
+TimeSegment TimeWindowSchedule::Stop(int stop) const{
+    TimeSegment segment;
+    segment.first = stop; segment.last = stop;
+    segment.duration = stops.serviceTime.at(stop);
+    segment.timeWarp = 0;
+    segment.earliest = stops.earliest.at(stop);
+    segment.latest = stops.latest.at(stop);
+    return segment;
+}
+
+// Concatenation of two segments with the drive from first.last to second.first in between
+// (Vidal et al., "A hybrid genetic algorithm with adaptive diversity management", 2013)
+TimeSegment TimeWindowSchedule::Join(const TimeSegment &first, const TimeSegment &second) const{
+    double travel = distance(first.last, second.first) / speed;
+    double delta = first.duration - first.timeWarp + travel;
+    double waiting = std::max(second.earliest - delta - first.latest, 0.0);
+    double warp = std::max(first.earliest + delta - second.latest, 0.0);
+
+    TimeSegment segment;
+    segment.first = first.first; segment.last = second.last;
+    segment.duration = first.duration + second.duration + travel + waiting;
+    segment.timeWarp = first.timeWarp + second.timeWarp + warp;
+    segment.earliest = std::max(second.earliest - delta, first.earliest) - waiting;
+    segment.latest = std::min(second.latest - delta, first.latest) + warp;
+    return segment;
+}
+
+// Computes the forward and backward segments of all routes
+void TimeWindowSchedule::Build(const QVector<QVector<int>> &routes){
+    forward.resize(routes.count());
+    backward.resize(routes.count());
+    for(int r = 0; r < routes.count(); r++)
+        Update(routes, r);
+}
+
+// Recomputes the segments of one route in O(length)
+void TimeWindowSchedule::Update(const QVector<QVector<int>> &routes, int route){
+    const QVector<int> &stopsOfRoute = routes.at(route);
+    int count = stopsOfRoute.count();
+    if(route >= forward.count()){
+        forward.resize(route + 1);
+        backward.resize(route + 1);
+    }
+    QVector<TimeSegment> &prefix = forward[route];
+    QVector<TimeSegment> &suffix = backward[route];
+    prefix.resize(count); suffix.resize(count);
+    if(count == 0)
+        return;
+    prefix[0] = Stop(stopsOfRoute.at(0));
+    for(int i = 1; i < count; i++)
+        prefix[i] = Join(prefix.at(i - 1), Stop(stopsOfRoute.at(i)));
+    suffix[count - 1] = Stop(stopsOfRoute.at(count - 1));
+    for(int i = count - 2; i >= 0; i--)
+        suffix[i] = Join(Stop(stopsOfRoute.at(i)), suffix.at(i + 1));
+}
+
+// True if the route meets every window
+bool TimeWindowSchedule::RouteFeasible(int route) const{
+    return forward.at(route).isEmpty() || Feasible(forward.at(route).last());
+}
+
+// Inserting stop between the positions position - 1 and position
+bool TimeWindowSchedule::CanInsert(int route, int position, int stop) const{
+    return Feasible(Join(Join(forward.at(route).at(position - 1), Stop(stop)), backward.at(route).at(position)));
+}
+
+// Removing the stop at position connects position - 1 and position + 1
+bool TimeWindowSchedule::CanRemove(int route, int position) const{
+    return Feasible(Join(forward.at(route).at(position - 1), backward.at(route).at(position + 1)));
+}
+
+// Both routes of a tail exchange (2-opt*) have to be feasible
+bool TimeWindowSchedule::CanExchangeTails(int routeA, int positionA, int routeB, int positionB) const{
+    return Feasible(Join(forward.at(routeA).at(positionA), backward.at(routeB).at(positionB))) &&
+           Feasible(Join(forward.at(routeB).at(positionB - 1), backward.at(routeA).at(positionA + 1)));
+}
@@ -0,0 +1,43 @@
+#ifndef TIMEWINDOWS_H
+#define TIMEWINDOWS_H
+
+#include <QVector>
+#include "stopstore.h"
+#include "distancefunction.h"
+
+// Summary of a sequence of stops that is driven without interruption: the time it takes, how much it
+// violates the time windows (time warp) and in which span its first service can start. Two sequences
+// are combined in O(1), so a move can be checked by concatenating the unchanged parts of its routes.
+struct TimeSegment
+{
+    int first, last; // first and last stop of the sequence
+    double duration; // travel, service and waiting time from the first service start to the end of the last service
+    double timeWarp; // sum of the window violations (0 if every service starts in time)
+    double earliest; // earliest service start at the first stop without additional waiting
+    double latest; // latest service start at the first stop without additional time warp
+};
+
+// Forward and backward time segments of the vehicle routes (depot at both ends). forward[i] covers the
+// stops [0, i] of a route and backward[i] the stops [i, end), so every insertion, removal or tail
+// exchange is checked with two concatenations.
+class TimeWindowSchedule
+{
+public:
+    TimeWindowSchedule(const DistanceFunction &distance, const StopStore &stops, double speed);
+    TimeSegment Stop(int stop) const; // segment of a single stop
+    TimeSegment Join(const TimeSegment &first, const TimeSegment &second) const; // first followed by second
+    static bool Feasible(const TimeSegment &segment) { return segment.timeWarp <= 1e-9; } // true if every window is met
+    void Build(const QVector<QVector<int>> &routes); // computes the segments of all routes
+    void Update(const QVector<QVector<int>> &routes, int route); // recomputes the segments of one route after a move
+    bool RouteFeasible(int route) const; // true if the route meets every window
+    bool CanInsert(int route, int position, int stop) const; // true if stop can be inserted before the given position
+    bool CanRemove(int route, int position) const; // true if the route stays feasible without the stop at position
+    bool CanExchangeTails(int routeA, int positionA, int routeB, int positionB) const; // A[0, positionA] + B[positionB, end) and B[0, positionB) + A(positionA, end)
+private:
+    const DistanceFunction &distance;
+    const StopStore &stops;
+    double speed; // distance per time unit
+    QVector<QVector<TimeSegment>> forward, backward;
+};
+
+#endif // TIMEWINDOWS_H
@@ -0,0 +1,118 @@
+#include "twoopt.h"
+
+static const double minimumGain = 1e-10; // smaller gains are treated as rounding noise
+
+TwoOpt::TwoOpt(const DistanceFunction &distance, const CandidateNeighbors &candidates, const ImprovementBudget &budget):
+    distance(distance),
+    candidates(candidates),
+    budget(budget),
+    stream(nullptr),
+    scratch(nullptr),
+    iterations(0),
+    queueHead(0),
+    queueSize(0)
+{
+
+}
+
+// Runs 2-opt until no improving move is left or the budget is used up and returns the route length
+double TwoOpt::Optimize(QVector<int> &route, const QVector<int> *firstStops){
+    iterations = 0;
+    if(route.count() < 4)
+        return distance.RouteLength(route);
+
+    BudgetTracker tracker(budget);
+    tour.swap(route);
+    if(scratch)
+        scratch->Swap(position, queue, queued);
+    position.fill(-1, distance.Count());
+    for(int i = 0; i < tour.count(); i++)
+        position[tour.at(i)] = i;
+
+    // Initially every stop (or every given stop) has to be looked at
+    queue.fill(0, tour.count());
+    queued.fill(false, distance.Count());
+    queueHead = 0; queueSize = 0;
+    for(int stop : firstStops ? *firstStops : tour){
+        if(position.at(stop) >= 0)
+            Push(stop);
+    }
+
+    while(queueSize > 0 && !tracker.Exhausted()){
+        int a = queue.at(queueHead);
+        queueHead = (queueHead + 1) % queue.count();
+        queueSize--;
+        queued[a] = false;
+        if(ImproveStop(a)){
+            tracker.CountIterations();
+            Push(a);
+            if(stream && stream->Due())
+                stream->Publish(tour, distance.RouteLength(tour));
+        }
+    }
+    iterations = tracker.Iterations();
+
+    if(scratch)
+        scratch->Swap(position, queue, queued);
+    route.swap(tour);
+    return distance.RouteLength(route);
+}
+
+// Tries to replace an edge (a, b) at a by the shorter edge (a, c) to a candidate c.
+// Both the successor and the predecessor edge of a are considered.
+bool TwoOpt::ImproveStop(int a){
+    for(int direction = 0; direction < 2; direction++){
+        int b = direction == 0 ? Next(a) : Prev(a);
+        double distanceAB = distance(a, b);
+        for(const int *candidate = candidates.Begin(a); candidate != candidates.End(a); ++candidate){
+            int c = *candidate;
+            double distanceAC = distance(a, c);
+            // Candidates are sorted, so no later one can give a positive partial gain
+            if(distanceAC >= distanceAB)
+                break;
+            int d = direction == 0 ? Next(c) : Prev(c);
+            if(c == b || d == a)
+                continue;
+            double delta = distanceAC + distance(b, d) - distanceAB - distance(c, d);
+            if(delta < -minimumGain){
+                // a b ... c d -> a c ... b d (successor) or d c ... a b -> d a ... c b (predecessor)
+                if(direction == 0)
+                    Reverse(position.at(b), position.at(c));
+                else
+                    Reverse(position.at(a), position.at(d));
+                Push(b); Push(c); Push(d);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Reverses the tour between two positions. The shorter side of the cycle is reversed,
+// which gives the same cycle.
+void TwoOpt::Reverse(int from, int to){
+    int count = tour.count();
+    int length = (to - from + count) % count + 1;
+    if(2 * length > count){
+        int oldFrom = from;
+        from = (to + 1) % count;
+        to = (oldFrom - 1 + count) % count;
+        length = count - length;
+    }
+    for(int i = 0; i < length / 2; i++){
+        int first = tour.at(from), second = tour.at(to);
+        tour[from] = second; position[second] = from;
+        tour[to] = first; position[first] = to;
+        from = from + 1 == count ? 0 : from + 1;
+        to = to == 0 ? count - 1 : to - 1;
+    }
+}
+
+// Clears the don't-look bit of a stop so that it is looked at again
+void TwoOpt::Push(int stop){
+    if(queued.at(stop))
+        return;
+    queued[stop] = true;
+    queue[(queueHead + queueSize) % queue.count()] = stop;
+    queueSize++;
+}
@@ -0,0 +1,42 @@
+#ifndef TWOOPT_H
+#define TWOOPT_H
+
+#include <QVector>
+#include "distancefunction.h"
+#include "candidateneighbors.h"
+#include "improvementbudget.h"
+#include "routestream.h"
+#include "improvementscratch.h"
+
+// 2-opt local search on a closed route. Only exchanges that create an edge to a candidate
+// neighbor are tried, and stops whose surroundings did not change are skipped (don't-look bits).
+class TwoOpt
+{
+public:
+    TwoOpt(const DistanceFunction &distance, const CandidateNeighbors &candidates, const ImprovementBudget &budget);
+    // Improves the closed route in place and returns its length. Only the firstStops are looked at in the
+    // beginning (nullptr: all stops), e.g. the stops next to the places where routes were joined.
+    double Optimize(QVector<int> &route, const QVector<int> *firstStops = nullptr);
+    int Iterations() const { return iterations; } // number of moves applied by the last run
+    void SetStream(RouteStream *stream) { this->stream = stream; } // publishes the improving route (nullptr: never)
+    void SetScratch(ImprovementScratch *scratch) { this->scratch = scratch; } // borrows the work arrays from the scratch (nullptr: own arrays)
+private:
+    const DistanceFunction &distance;
+    const CandidateNeighbors &candidates;
+    ImprovementBudget budget;
+    RouteStream *stream; // receives the best route so far (nullptr: none)
+    ImprovementScratch *scratch; // lends the work arrays of a run (nullptr: the stage's own)
+    int iterations;
+    QVector<int> tour; // route that is improved
+    QVector<int> position; // position of every stop in the tour
+    QVector<int> queue; // ring buffer of the stops whose don't-look bit is off
+    QVector<bool> queued; // don't-look bit cleared (stop is in the queue)
+    int queueHead, queueSize;
+    int Next(int stop) const { return tour.at(position.at(stop) + 1 == tour.count() ? 0 : position.at(stop) + 1); }
+    int Prev(int stop) const { return tour.at(position.at(stop) == 0 ? tour.count() - 1 : position.at(stop) - 1); }
+    bool ImproveStop(int a); // applies the first improving move around stop a
+    void Reverse(int from, int to); // reverses the tour between the positions from and to (cyclic, inclusive)
+    void Push(int stop); // clears the don't-look bit of a stop
+};
+
+#endif // TWOOPT_H